@@ -15,8 +15,10 @@
 #include <QFile>
 #include <QDir>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QDateTime>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QTime>
 #include <QSettings>
 #include <QStandardPaths>
@@ -24,10 +26,18 @@
 #include <QStandardItemModel>
 #include <QCoreApplication>
 #include <QSharedMemory>
+#include <QLockFile>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QUuid>
+#include <QRandomGenerator>
 #include <QTextStream>
 #include <QThread>
+#include <QMutex>
+#include <QThreadPool>
+#include <QPointer>
+#include <QSocketNotifier>
+#include <QAbstractEventDispatcher>
 #include <QAbstractNativeEventFilter>
 #include <QEvent>
 #include <QKeyEvent>
@@ -42,6 +52,7 @@
 #include <QPixmap>
 #include <QImage>
 #include <QMetaType>
+#include <QtEndian>
 
 #include <QApplication>
 #include <QScreen>
@@ -51,6 +62,7 @@
 #include <QTimeEdit>
 #include <QCheckBox>
 #include <QMainWindow>
+#include <QStatusBar>
 #include <QGroupBox>
 #include <QWidget>
 #include <QDialog>
@@ -63,6 +75,8 @@
 #include <QListWidget>
 #include <QTreeView>
 #include <QTableView>
+#include <QTableWidget>
+#include <QHeaderView>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
@@ -88,23 +102,40 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QJsonValue>
+#include <QCborValue>
 #include <QNetworkReply>
+#include <QUrlQuery>
+#include <QNetworkInformation>
+#include <QLocalServer>
+#include <QLocalSocket>
 
 #include <memory>
 #include <algorithm>
+#include <atomic>
 #include <vector>
+#include <limits>
 #include <string>
 #include <functional>
 #include <csignal>
 #include <cstdlib>
+#include <cerrno>
+#include <cstring>
 #include <unistd.h>
 #include <sys/types.h>
 #include <signal.h>
 #include <pwd.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <fcntl.h>
 
+#ifdef FOCCUSS_HAVE_XXHASH
+#include <xxhash.h>
+#endif
+
 #include "X11Includes.h"
 
 #endif // COMMON_H 
\ No newline at end of file
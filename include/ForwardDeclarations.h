@@ -11,13 +11,27 @@ class BlockTimeSettingsModel;
 // Core classes
 class AppDetector;
 class AppMonitor;
+class X11Connection;
+class ProcessTerminator;
+class CgroupFreezer;
+class ProcessIdentity;
+class UsageTracker;
+class BlockEventLog;
+class RuleIndex;
+class ContentHasher;
+class AhoCorasick;
+class PatternSet;
+class TitleWatcher;
 
 // Service classes
 class LinuxService;
+class ApiService;
 
 // UI classes
 class MainWindow;
 class BlockOverlay;
+class OverlayPool;
+class NativeOverlay;
 
 struct REG_Week;
 
@@ -36,6 +36,8 @@
 #include <X11/Xutil.h>
 #include <X11/extensions/Xrandr.h>
 #include <X11/extensions/shape.h>
+#include <X11/extensions/sync.h>
+#include <X11/extensions/scrnsaver.h>
 #include <xcb/xcb.h>
 
 // Outras dependências do sistema
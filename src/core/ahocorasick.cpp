@@ -0,0 +1,132 @@
+#include "ahocorasick.h"
+
+AhoCorasick::AhoCorasick()
+{
+    build(QStringList());
+}
+
+void AhoCorasick::build(const QStringList& keywords)
+{
+    m_keywords = keywords;
+    m_nodes.clear();
+    m_nodes.push_back(Node{{}, 0, -1, {}, -1});
+
+    for (int index = 0; index < keywords.size(); ++index) {
+        const QString folded = keywords.at(index).toCaseFolded();
+        if (folded.isEmpty())
+            continue;
+
+        int node = 0;
+        for (QChar qc : folded) {
+            char16_t c = qc.unicode();
+            int next = child(node, c);
+            if (next < 0) {
+                next = int(m_nodes.size());
+                m_nodes.push_back(Node{{}, 0, -1, {}, -1});
+                auto& edges = m_nodes[node].edges;
+                auto pos = std::lower_bound(edges.begin(), edges.end(), std::make_pair(c, 0));
+                edges.insert(pos, std::make_pair(c, next));
+            }
+            node = next;
+        }
+
+        if (m_nodes[node].output < 0)
+            m_nodes[node].output = index;
+        m_nodes[node].ends.push_back(index);
+    }
+
+    // Breadth-first, so a node's fail target is always finished before it
+    std::vector<int> queue;
+    for (const auto& edge : m_nodes[0].edges) {
+        m_nodes[edge.second].fail = 0;
+        queue.push_back(edge.second);
+    }
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int node = queue[head];
+        for (const auto& edge : m_nodes[node].edges) {
+            int fail = m_nodes[node].fail;
+            while (fail != 0 && child(fail, edge.first) < 0)
+                fail = m_nodes[fail].fail;
+
+            int target = child(fail, edge.first);
+            m_nodes[edge.second].fail = (target >= 0 && target != edge.second) ? target : 0;
+
+            const Node& failNode = m_nodes[m_nodes[edge.second].fail];
+            if (m_nodes[edge.second].output < 0)
+                m_nodes[edge.second].output = failNode.output;
+            m_nodes[edge.second].dictLink = failNode.ends.empty() ? failNode.dictLink
+                                                                  : m_nodes[edge.second].fail;
+
+            queue.push_back(edge.second);
+        }
+    }
+}
+
+bool AhoCorasick::isEmpty() const
+{
+    return m_nodes.size() <= 1;
+}
+
+int AhoCorasick::findFirst(const QString& text) const
+{
+    if (isEmpty())
+        return -1;
+
+    int node = 0;
+    for (QChar qc : text.toCaseFolded()) {
+        char16_t c = qc.unicode();
+        int next = child(node, c);
+        while (next < 0 && node != 0) {
+            node = m_nodes[node].fail;
+            next = child(node, c);
+        }
+        node = next < 0 ? 0 : next;
+
+        if (m_nodes[node].output >= 0)
+            return m_nodes[node].output;
+    }
+
+    return -1;
+}
+
+std::vector<int> AhoCorasick::findAll(const QString& text) const
+{
+    std::vector<int> found;
+    if (isEmpty())
+        return found;
+
+    int node = 0;
+    for (QChar qc : text.toCaseFolded()) {
+        char16_t c = qc.unicode();
+        int next = child(node, c);
+        while (next < 0 && node != 0) {
+            node = m_nodes[node].fail;
+            next = child(node, c);
+        }
+        node = next < 0 ? 0 : next;
+
+        // Keywords that end here, then the shorter ones that are suffixes of them
+        for (int match = node; match > 0; match = m_nodes[match].dictLink) {
+            found.insert(found.end(), m_nodes[match].ends.begin(), m_nodes[match].ends.end());
+        }
+    }
+
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    return found;
+}
+
+QString AhoCorasick::keyword(int index) const
+{
+    return m_keywords.value(index);
+}
+
+int AhoCorasick::child(int node, char16_t c) const
+{
+    const auto& edges = m_nodes[node].edges;
+    auto pos = std::lower_bound(edges.begin(), edges.end(), std::make_pair(c, 0));
+    if (pos != edges.end() && pos->first == c)
+        return pos->second;
+    return -1;
+}
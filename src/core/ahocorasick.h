@@ -0,0 +1,45 @@
+#pragma once
+#ifndef AHOCORASICK_H
+#define AHOCORASICK_H
+
+#include "../../include/Common.h"
+
+// Case-insensitive multi-keyword matcher. All keywords are compiled into one
+// automaton, so a text is checked against every keyword in a single pass
+// over its characters, however many keywords there are.
+class AhoCorasick
+{
+public:
+    AhoCorasick();
+
+    void build(const QStringList& keywords);
+    bool isEmpty() const;
+
+    // Index into the keywords given to build() of the first keyword found
+    // in text, or -1
+    int findFirst(const QString& text) const;
+    // Indices of every keyword found in text, ascending and without repeats
+    std::vector<int> findAll(const QString& text) const;
+    QString keyword(int index) const;
+
+private:
+    struct Node
+    {
+        // Sorted by character for binary search
+        std::vector<std::pair<char16_t, int>> edges;
+        int fail;
+        // Keyword ending here, or reachable through the fail chain; -1 if none
+        int output;
+        // Every keyword ending exactly here; equal keywords share a node
+        std::vector<int> ends;
+        // Nearest node on the fail chain with keywords of its own; -1 if none
+        int dictLink;
+    };
+
+    int child(int node, char16_t c) const;
+
+    std::vector<Node> m_nodes;
+    QStringList m_keywords;
+};
+
+#endif // AHOCORASICK_H
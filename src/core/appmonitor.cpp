@@ -1,6 +1,10 @@
 #include "appmonitor.h"
 #include "../data/database.h"
 #include "../data/appmodel.h"
+#include "x11connection.h"
+#include "processidentity.h"
+#include "ruleindex.h"
+#include "titlewatcher.h"
 
 static QString s_logFilePath;
 
@@ -24,14 +28,36 @@ void logToFileAM(const QString& message)
     }
 }
 
+// Below this a desktop scan is a few milliseconds and threads only add overhead
+static const size_t kParallelScanThreshold = 4096;
+static const size_t kScanShardSize = 256;
+
+static QString enforcerLockPath()
+{
+    QDir appDataDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    appDataDir.mkpath(".");
+    return appDataDir.filePath("foccuss_monitor.lock");
+}
+
 AppMonitor::AppMonitor(Database* database, QObject *parent)
     : QObject(parent),
       m_database(database),
       m_isMonitoring(false),
-      m_display(nullptr)
+      m_wasBlocking(false),
+      m_display(nullptr),
+      m_ruleIndex(nullptr),
+      m_titleWatcher(nullptr),
+      m_enforcerLock(enforcerLockPath())
 {
+    // The lock is held for the whole run, so its age says nothing about staleness
+    m_enforcerLock.setStaleLockTime(0);
+    m_ruleIndex = new RuleIndex(m_database, this);
+    m_titleWatcher = new TitleWatcher(m_database, this);
+    connect(m_titleWatcher, &TitleWatcher::titleMatched, this, &AppMonitor::onTitleMatched);
+    m_scanPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
     m_monitorTimer.setInterval(1000);
     connect(&m_monitorTimer, &QTimer::timeout, this, &AppMonitor::checkRunningApps);
+    connect(X11Connection::instance(), &X11Connection::userIdleChanged, this, &AppMonitor::onUserIdleChanged);
     initializeX11();
 }
 
@@ -42,7 +68,7 @@ AppMonitor::~AppMonitor()
 
 void AppMonitor::initializeX11()
 {
-    m_display = XOpenDisplay(nullptr);
+    m_display = X11Connection::instance()->display();
     if (!m_display) {
         logToFileAM("Failed to open X11 display");
     }
@@ -50,16 +76,19 @@ void AppMonitor::initializeX11()
 
 void AppMonitor::cleanupX11()
 {
-    if (m_display) {
-        XCloseDisplay(m_display);
-        m_display = nullptr;
-    }
+    // The display belongs to the shared X11Connection
+    m_display = nullptr;
 }
 
 void AppMonitor::startMonitoring()
 {
     if (!m_isMonitoring && m_database && m_database->isInitialized()) {
-        m_monitorTimer.start();
+        // Nobody can launch anything while the session is idle or locked,
+        // so the scan timer only runs while the user is around
+        X11Connection::instance()->watchIdle(X11Connection::kIdleThresholdMs);
+        if (!X11Connection::instance()->isUserIdle()) {
+            m_monitorTimer.start();
+        }
         m_isMonitoring = true;
         m_windowCache.clear();
         
@@ -81,6 +110,15 @@ void AppMonitor::stopMonitoring()
         m_monitorTimer.stop();
         m_isMonitoring = false;
         m_windowCache.clear();
+        m_titleWatcher->stopWatching();
+        
+        if (m_wasBlocking) {
+            m_wasBlocking = false;
+            emit blockingPeriodEnded();
+        }
+        if (m_enforcerLock.isLocked()) {
+            m_enforcerLock.unlock();
+        }
     }
 }
 
@@ -89,182 +127,268 @@ bool AppMonitor::isMonitoring() const
     return m_isMonitoring;
 }
 
-QString AppMonitor::getProcessPath(pid_t pid)
+void AppMonitor::onUserIdleChanged(bool idle)
+{
+    if (!m_isMonitoring)
+        return;
+
+    if (idle) {
+        logToFileAM("Session idle, pausing scans");
+        m_monitorTimer.stop();
+        return;
+    }
+
+    // Catch up on anything started by scripts or timers while away
+    logToFileAM("Session active, resuming scans");
+    m_monitorTimer.start();
+    checkRunningApps();
+}
+
+void AppMonitor::onTitleMatched(X11Window window, const QString& title, const QString& keyword)
 {
-    QString path = QString("/proc/%1/exe").arg(pid);
-    char exePath[PATH_MAX];
-    ssize_t len = readlink(path.toStdString().c_str(), exePath, sizeof(exePath) - 1);
+    pid_t pid = X11Connection::instance()->windowPid(window);
+    if (pid <= 0 || pid == getpid() || !ownsEnforcement())
+        return;
+
+    logToFileAM("Window title matched \"" + keyword + "\": " + title);
+
+    // Only the process owning the window is affected, not the whole app
+    emit blockedAppLaunched(window, ProcessIdentity::resolve(pid), keyword,
+                            QList<ProcessRef>{ProcessIdentity::ref(pid)}, "title:" + keyword);
+}
+
+std::vector<pid_t> AppMonitor::listProcesses()
+{
+    std::vector<pid_t> pids;
     
-    if (len != -1) {
-        exePath[len] = '\0';
-        QString processPath = QString(exePath);
-        
-        QFile cmdlineFile(QString("/proc/%1/cmdline").arg(pid));
-        if (cmdlineFile.open(QIODevice::ReadOnly)) {
-            QByteArray cmdline = cmdlineFile.readAll();
-            cmdlineFile.close();
-            
-            QString cmdlineStr = QString::fromUtf8(cmdline);
-            if (cmdlineStr.contains("flatpak")) {
-                QRegularExpression rx("flatpak run ([^\\s]+)");
-                QRegularExpressionMatch match = rx.match(cmdlineStr);
-                if (match.hasMatch()) {
-                    return QString("flatpak run %1").arg(match.captured(1));
-                }
+    DIR* procDir = opendir("/proc");
+    if (!procDir)
+        return pids;
+    
+    struct dirent* entry;
+    while ((entry = readdir(procDir)) != nullptr) {
+        bool isNumeric = true;
+        for (int i = 0; entry->d_name[i] != '\0'; i++) {
+            if (!isdigit(entry->d_name[i])) {
+                isNumeric = false;
+                break;
             }
         }
         
-        if (processPath.startsWith("/snap/")) {
-            QFileInfo snapInfo(processPath);
-            QString snapName = snapInfo.fileName();
-            return QString("/snap/bin/%1").arg(snapName);
+        if (isNumeric) {
+            pids.push_back(atoi(entry->d_name));
         }
-        
-        return processPath;
     }
     
-    return QString();
+    closedir(procDir);
+    return pids;
 }
 
-QString AppMonitor::getWindowName(Window window)
+void AppMonitor::scanShards(const std::vector<pid_t>& pids, std::atomic<size_t>& nextShard,
+                            std::vector<ProcessMatch>& matches) const
 {
-    if (!m_display) return QString();
+    // Per thread, so no /proc read or match result is shared until the merge
+    std::vector<char> cmdlineBuffer;
     
-    XTextProperty name;
-    if (XGetWMName(m_display, window, &name) && name.value) {
-        QString windowName = QString::fromUtf8(reinterpret_cast<char*>(name.value));
-        XFree(name.value);
-        return windowName;
+    for (;;) {
+        const size_t begin = nextShard.fetch_add(kScanShardSize, std::memory_order_relaxed);
+        if (begin >= pids.size())
+            break;
+        
+        const size_t end = qMin(begin + kScanShardSize, pids.size());
+        for (size_t i = begin; i < end; ++i) {
+            const pid_t pid = pids[i];
+            QString rulePath = m_ruleIndex->match(pid, cmdlineBuffer);
+            if (rulePath.isEmpty())
+                continue;
+            
+            // The start time travels with the pid, so a kill requested long
+            // after this scan cannot hit a process that reused the pid
+            ProcessMatch match = { pid, 0, 0, rulePath };
+            if (ProcessIdentity::readStat(pid, &match.parent, &match.startTime)) {
+                matches.push_back(match);
+            }
+        }
     }
-    
-    return QString();
 }
 
-Window AppMonitor::findWindowByPid(pid_t pid)
+QHash<pid_t, Window> AppMonitor::mapWindowsByPid()
 {
+    QHash<pid_t, Window> windows;
     if (!m_display)
-        return None;
+        return windows;
     
+    X11Connection* connection = X11Connection::instance();
     Window root = DefaultRootWindow(m_display);
     Window parent, root_return, *children;
     unsigned int nchildren;
     
     if (XQueryTree(m_display, root, &root_return, &parent, &children, &nchildren)) {
         for (unsigned int i = 0; i < nchildren; i++) {
-            Window window = children[i];
-            
-            Atom actualType;
-            int actualFormat;
-            unsigned long nItems, bytesAfter;
-            unsigned char* prop = nullptr;
-            
-            if (XGetWindowProperty(m_display, window, 
-                                 XInternAtom(m_display, "_NET_WM_PID", False),
-                                 0, 1, False, XA_CARDINAL, 
-                                 &actualType, &actualFormat, 
-                                 &nItems, &bytesAfter, &prop) == Success) {
-                
-                if (prop && nItems > 0 && actualFormat == 32) {
-                    pid_t windowPid = *reinterpret_cast<pid_t*>(prop);
-                    
-                    if (windowPid == pid) {
-                        XFree(prop);
-                        XFree(children);
-                        return window;
-                    }
-                }
-                
-                if (prop)
-                    XFree(prop);
+            pid_t windowPid = connection->windowPid(children[i]);
+            // Keep the first (bottom-most) window of each process, as the per-PID lookup did
+            if (windowPid > 0 && !windows.contains(windowPid)) {
+                windows.insert(windowPid, children[i]);
             }
         }
         XFree(children);
     }
     
-    return None;
+    return windows;
+}
+
+bool AppMonitor::ownsEnforcement()
+{
+    if (m_enforcerLock.isLocked())
+        return true;
+
+    // Retried on every scan, so this monitor takes over once the other exits
+    if (!m_enforcerLock.tryLock(0))
+        return false;
+
+    logToFileAM("Enforcing block rules in this process");
+    return true;
 }
 
 void AppMonitor::checkRunningApps()
 {
-    if (!m_database || !m_database->isInitialized())
+    if (!m_database || !m_database->isInitialized() || !ownsEnforcement())
+        return;
+
+    if (!m_database->isBlockingActive() || !m_database->isBlockingNow()) {
+        if (m_wasBlocking) {
+            m_wasBlocking = false;
+            m_windowCache.clear();
+            m_titleWatcher->stopWatching();
+            emit blockingPeriodEnded();
+        }
         return;
+    }
+    m_wasBlocking = true;
 
-    if (!m_database->isBlockingActive() || !m_database->isBlockingNow())
+    // Titles are event driven; this only picks up rule changes
+    if (m_titleWatcher->isWatching()) {
+        m_titleWatcher->refresh();
+    } else {
+        m_titleWatcher->startWatching();
+    }
+
+    // Re-reads the rules only when they changed since the last scan
+    m_ruleIndex->refresh();
+    if (m_ruleIndex->isEmpty()) {
+        m_windowCache.clear();
         return;
+    }
 
-    QSet<Window> currentActiveWindows;
-    
-    DIR* procDir = opendir("/proc");
-    if (!procDir) {
+    const std::vector<pid_t> pids = listProcesses();
+    if (pids.empty()) {
         logToFileAM("Failed to open /proc directory");
         return;
     }
     
-    struct dirent* entry;
-    while ((entry = readdir(procDir)) != nullptr) {
-        bool isNumeric = true;
-        for (int i = 0; entry->d_name[i] != '\0'; i++) {
-            if (!isdigit(entry->d_name[i])) {
-                isNumeric = false;
-                break;
-            }
+    // Hosts with tens of thousands of processes spread the per-process
+    // syscalls over all cores. Shards are claimed from a shared counter, so
+    // a thread that draws cheap processes simply takes more shards.
+    int threadCount = 1;
+    if (pids.size() >= kParallelScanThreshold) {
+        threadCount = qMin(m_scanPool.maxThreadCount() + 1,
+                           int((pids.size() + kScanShardSize - 1) / kScanShardSize));
+    }
+    
+    std::atomic<size_t> nextShard(0);
+    std::vector<std::vector<ProcessMatch>> threadMatches(threadCount);
+    for (int i = 1; i < threadCount; ++i) {
+        m_scanPool.start([this, &pids, &nextShard, &threadMatches, i]() {
+            scanShards(pids, nextShard, threadMatches[i]);
+        });
+    }
+    scanShards(pids, nextShard, threadMatches[0]);
+    m_scanPool.waitForDone();
+    m_ruleIndex->pruneRetired();
+    
+    QHash<pid_t, pid_t> parents;
+    QHash<pid_t, quint64> startTimes;
+    QHash<pid_t, QString> matchedPaths;
+    for (const auto& matches : threadMatches) {
+        for (const ProcessMatch& match : matches) {
+            matchedPaths.insert(match.pid, match.rulePath);
+            parents.insert(match.pid, match.parent);
+            startTimes.insert(match.pid, match.startTime);
         }
-        
-        if (!isNumeric) continue;
-        
-        pid_t pid = atoi(entry->d_name);
-        QString processPath = getProcessPath(pid);
-        
-        if (processPath.isEmpty() || processPath.contains("foccuss")) {
+    }
+    
+    // Collapse helpers into the top-most matching ancestor, so a browser
+    // with dozens of renderers is a single app instance. Each pid's top is
+    // resolved once and shared by the whole chain below it. Parents are
+    // read one process at a time and pids get reused, so a chain can loop;
+    // every member of a loop gets the same root, its smallest pid.
+    QHash<pid_t, pid_t> tops;
+    for (auto it = matchedPaths.constBegin(); it != matchedPaths.constEnd(); ++it) {
+        if (tops.contains(it.key()))
             continue;
-        }
         
-        bool isBlocked = false;
-        QList<std::shared_ptr<AppModel>> blockedApps = m_database->getBlockedApps();
-        for (const auto& app : blockedApps) {
-            QString blockedPath = app->getPath();
+        QList<pid_t> chain;
+        QHash<pid_t, int> positions;
+        pid_t current = it.key();
+        pid_t top = current;
+        for (;;) {
+            auto known = tops.constFind(current);
+            if (known != tops.constEnd()) {
+                top = known.value();
+                break;
+            }
+            auto seen = positions.constFind(current);
+            if (seen != positions.constEnd()) {
+                top = *std::min_element(chain.constBegin() + seen.value(), chain.constEnd());
+                break;
+            }
             
-            if (blockedPath.startsWith("flatpak run ")) {
-                if (processPath.startsWith("flatpak run ") && 
-                    processPath.contains(blockedPath.mid(12))) {
-                    isBlocked = true;
-                    break;
-                }
-            } else if (blockedPath.startsWith("/snap/bin/")) {
-                if (processPath.startsWith("/snap/bin/") && 
-                    processPath.endsWith(blockedPath.mid(10))) {
-                    isBlocked = true;
-                    break;
-                }
-            } else if (processPath == blockedPath) {
-                isBlocked = true;
+            positions.insert(current, int(chain.size()));
+            chain.append(current);
+            
+            pid_t parentPid = parents.value(current);
+            if (matchedPaths.value(parentPid) != it.value()) {
+                top = current;
                 break;
             }
+            current = parentPid;
         }
-
-        if (isBlocked) {
-            Window window = findWindowByPid(pid);
-            if (window != None) {
-                currentActiveWindows.insert(window);
-                if (!m_windowCache.contains(window)) {
-                    m_windowCache.insert(window);
-                    QString processName = QFileInfo(processPath).fileName();
-
-                    emit blockedAppLaunched(window, processPath, processName);
-                    QThread::msleep(100);
-                }
-            }
+        
+        for (pid_t member : std::as_const(chain)) {
+            tops.insert(member, top);
         }
     }
     
-    closedir(procDir);
-    
-    QSet<Window> windowsToRemove = m_windowCache;
-    windowsToRemove.subtract(currentActiveWindows);
+    QMap<pid_t, QList<ProcessRef>> instances;
+    for (auto it = matchedPaths.constBegin(); it != matchedPaths.constEnd(); ++it) {
+        instances[tops.value(it.key())].append(ProcessRef{it.key(), startTimes.value(it.key())});
+    }
     
-    if (!windowsToRemove.empty()) {
-        for (const auto& window : windowsToRemove) {
-            m_windowCache.remove(window);
+    QSet<Window> currentActiveWindows;
+    if (!instances.isEmpty()) {
+        const QHash<pid_t, Window> windows = mapWindowsByPid();
+        
+        for (auto it = instances.constBegin(); it != instances.constEnd(); ++it) {
+            // The instance root usually owns the window; fall back to any helper that does
+            Window window = windows.value(it.key(), None);
+            for (const ProcessRef& process : it.value()) {
+                if (window != None)
+                    break;
+                window = windows.value(process.pid, None);
+            }
+            
+            if (window == None)
+                continue;
+            
+            currentActiveWindows.insert(window);
+            if (!m_windowCache.contains(window)) {
+                m_windowCache.insert(window);
+                const QString& appPath = matchedPaths.value(it.key());
+                emit blockedAppLaunched(window, appPath, QFileInfo(appPath).fileName(), it.value(), appPath);
+            }
         }
     }
-}
\ No newline at end of file
+    
+    // Forget windows that are gone so a relaunch is reported again
+    m_windowCache.intersect(currentActiveWindows);
+}
@@ -3,9 +3,12 @@
 #define APPMONITOR_H
 
 #include "../../include/Common.h"
+#include "processidentity.h"
 
 class AppModel;
 class Database;
+class RuleIndex;
+class TitleWatcher;
 
 class AppMonitor : public QObject
 {
@@ -20,25 +23,56 @@ public:
     bool isMonitoring() const;
     
 signals:
-    void blockedAppLaunched(Window targetWindow, const QString& appPath, const QString& appName);
+    // One emission per app instance: processes holds the top-most matching
+    // process and every matching descendant of it. ruleKey names the rule
+    // that matched (see BlockEvent); for executable rules it is appPath.
+    void blockedAppLaunched(Window targetWindow, const QString& appPath, const QString& appName,
+                            const QList<ProcessRef>& processes, const QString& ruleKey);
+    // Blocking was switched off or the scheduled window closed
+    void blockingPeriodEnded();
     
 private slots:
     void checkRunningApps();
+    void onTitleMatched(X11Window window, const QString& title, const QString& keyword);
+    void onUserIdleChanged(bool idle);
     
 private:
     void initializeX11();
     void cleanupX11();
-    Window findWindowByPid(pid_t pid);
-    QString getWindowName(Window window);
-    QString getProcessPath(pid_t pid);
+    // _NET_WM_PID -> top-level window, from a single XQueryTree per scan
+    QHash<pid_t, Window> mapWindowsByPid();
+    
+    struct ProcessMatch
+    {
+        pid_t pid;
+        pid_t parent;
+        quint64 startTime;
+        QString rulePath;
+    };
+    
+    // True while this process is the one enforcing rules, see m_enforcerLock
+    bool ownsEnforcement();
+    static std::vector<pid_t> listProcesses();
+    // Claims shards of pids until none are left; run by every scan thread
+    void scanShards(const std::vector<pid_t>& pids, std::atomic<size_t>& nextShard,
+                    std::vector<ProcessMatch>& matches) const;
     
     Database* m_database;
     QTimer m_monitorTimer;
     bool m_isMonitoring;
+    bool m_wasBlocking;
     
-    // X11 display connection
+    // Shared X11 display connection
     Display* m_display;
     
+    RuleIndex* m_ruleIndex;
+    TitleWatcher* m_titleWatcher;
+    // Helpers for large scans; the monitor thread takes shards as well
+    QThreadPool m_scanPool;
+    // The GUI and the daemon both run a monitor; only the holder of this lock
+    // acts on matches, so an app is never blocked or logged twice
+    QLockFile m_enforcerLock;
+    
     // Cache previously detected processes to avoid repeatedly signaling
     QSet<Window> m_windowCache;
 };
@@ -0,0 +1,90 @@
+#include "blockeventlog.h"
+
+static QString s_logFilePath;
+
+void logToFileBE(const QString& message)
+{
+    if (s_logFilePath.isEmpty()) {
+        QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir appDataDir(appDataPath);
+        if (!appDataDir.exists()) {
+            appDataDir.mkpath(".");
+        }
+        s_logFilePath = appDataDir.filePath("foccuss_service.log");
+    }
+
+    QFile logFile(s_logFilePath);
+    if (logFile.open(QIODevice::Append | QIODevice::Text)) {
+        QTextStream out(&logFile);
+        out << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
+            << " - " << message << "\n";
+        logFile.close();
+    }
+}
+
+static const int kFlushDelayMs = 5000;
+// Bound on memory if the database stays unwritable; the oldest events go first
+static const int kMaxQueuedEvents = 10000;
+
+BlockEventLog::BlockEventLog(Database* database, QObject *parent)
+    : QObject(parent),
+      m_database(database)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kFlushDelayMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &BlockEventLog::flush);
+
+    if (m_database) {
+        m_hitCounts = m_database->getBlockHitCounts();
+    }
+}
+
+BlockEventLog::~BlockEventLog()
+{
+    flush();
+}
+
+void BlockEventLog::record(const QString& ruleKey, const QString& appPath, const QString& appName,
+                           const QString& action, int processCount)
+{
+    BlockEvent event;
+    event.id = 0;
+    event.occurredAt = QDateTime::currentMSecsSinceEpoch();
+    event.ruleKey = ruleKey;
+    event.appPath = appPath;
+    event.appName = appName;
+    event.action = action;
+    event.processCount = processCount;
+
+    if (m_queue.size() >= kMaxQueuedEvents) {
+        m_queue.removeFirst();
+    }
+    m_queue.append(event);
+    m_pendingHits[ruleKey]++;
+    m_hitCounts[ruleKey]++;
+
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+qint64 BlockEventLog::hitCount(const QString& ruleKey) const
+{
+    return m_hitCounts.value(ruleKey);
+}
+
+void BlockEventLog::flush()
+{
+    m_flushTimer.stop();
+
+    if (!m_database || (m_queue.isEmpty() && m_pendingHits.isEmpty()))
+        return;
+
+    if (m_database->appendBlockEvents(m_queue, m_pendingHits)) {
+        m_queue.clear();
+        m_pendingHits.clear();
+    } else {
+        logToFileBE(QString("Failed to write %1 block events, retrying later").arg(m_queue.size()));
+        m_flushTimer.start();
+    }
+}
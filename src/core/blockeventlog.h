@@ -0,0 +1,38 @@
+#pragma once
+#ifndef BLOCKEVENTLOG_H
+#define BLOCKEVENTLOG_H
+
+#include "../../include/Common.h"
+#include "../data/database.h"
+
+// Write-behind queue for block events. Detections are only appended in
+// memory; a timer writes everything queued, plus the per-rule hit deltas,
+// in one transaction a few seconds after the first unflushed event.
+class BlockEventLog : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BlockEventLog(Database* database, QObject *parent = nullptr);
+    ~BlockEventLog();
+
+    // ruleKey names the rule that matched, see BlockEvent
+    void record(const QString& ruleKey, const QString& appPath, const QString& appName,
+                const QString& action, int processCount);
+
+    // Persisted hits plus the ones still queued
+    qint64 hitCount(const QString& ruleKey) const;
+
+public slots:
+    void flush();
+
+private:
+    Database* m_database;
+    QTimer m_flushTimer;
+
+    QList<BlockEvent> m_queue;
+    QHash<QString, qint64> m_pendingHits;
+    QHash<QString, qint64> m_hitCounts;
+};
+
+#endif // BLOCKEVENTLOG_H
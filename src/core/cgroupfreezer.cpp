@@ -0,0 +1,395 @@
+#include "cgroupfreezer.h"
+
+static QString s_logFilePath;
+
+void logToFileCF(const QString& message)
+{
+    if (s_logFilePath.isEmpty()) {
+        QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir appDataDir(appDataPath);
+        if (!appDataDir.exists()) {
+            appDataDir.mkpath(".");
+        }
+        s_logFilePath = appDataDir.filePath("foccuss_service.log");
+    }
+
+    QFile logFile(s_logFilePath);
+    if (logFile.open(QIODevice::Append | QIODevice::Text)) {
+        QTextStream out(&logFile);
+        out << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
+            << " - " << message << "\n";
+        logFile.close();
+    }
+}
+
+static const char* const kSliceName = "foccuss.slice";
+
+CgroupFreezer::CgroupFreezer(QObject *parent)
+    : QObject(parent),
+      m_mountPath("/sys/fs/cgroup")
+{
+    if (!QFile::exists(m_mountPath + "/cgroup.controllers")) {
+        logToFileCF("cgroup v2 hierarchy not mounted, freezing is unavailable");
+        return;
+    }
+
+    m_rootPath = findDelegatedRoot();
+    if (m_rootPath.isEmpty()) {
+        logToFileCF("No writable cgroup subtree found, freezing is unavailable");
+    }
+}
+
+CgroupFreezer::~CgroupFreezer()
+{
+    // Never leave anything frozen behind
+    thawAll();
+}
+
+bool CgroupFreezer::isAvailable() const
+{
+    return !m_rootPath.isEmpty();
+}
+
+QString CgroupFreezer::findDelegatedRoot() const
+{
+    if (geteuid() == 0) {
+        return m_mountPath;
+    }
+
+    // An unprivileged user may only move processes inside the subtree
+    // systemd delegates to its user manager
+    const QString ownCgroup = processCgroup(getpid());
+    const QString managerUnit = QString("user@%1.service").arg(geteuid());
+
+    QStringList components = ownCgroup.split('/', Qt::SkipEmptyParts);
+    int index = components.indexOf(managerUnit);
+    if (index < 0) {
+        return QString();
+    }
+
+    QString rootPath = m_mountPath + "/" + components.mid(0, index + 1).join('/');
+    if (access(QFile::encodeName(rootPath + "/cgroup.procs").constData(), W_OK) != 0) {
+        return QString();
+    }
+
+    return rootPath;
+}
+
+QString CgroupFreezer::groupName(const QString& appPath)
+{
+    QString name;
+    name.reserve(appPath.size());
+    for (const QChar c : appPath) {
+        name.append(c.isLetterOrNumber() || c == '.' || c == '-' ? c : QChar('_'));
+    }
+
+    while (name.startsWith('_') || name.startsWith('.')) {
+        name.remove(0, 1);
+    }
+
+    return name.left(200);
+}
+
+QString CgroupFreezer::managerRoot(const QString& cgroup) const
+{
+    // Our own group always lives inside the user manager that owns the
+    // process, never next to systemd's top-level slices
+    const QStringList components = cgroup.split('/', Qt::SkipEmptyParts);
+    for (int i = 0; i < components.size(); ++i) {
+        if (components.at(i).startsWith("user@") && components.at(i).endsWith(".service")) {
+            return m_mountPath + "/" + components.mid(0, i + 1).join('/');
+        }
+    }
+
+    return QString();
+}
+
+bool CgroupFreezer::isOwnCgroup(const QString& cgroup, const QSet<pid_t>& tree) const
+{
+    const QString path = m_mountPath + cgroup;
+    if (cgroup == processCgroup(getpid()) || !path.startsWith(m_rootPath + "/")) {
+        return false;
+    }
+
+    // Freezing a cgroup freezes everything below it as well
+    if (!QDir(path).entryList(QDir::Dirs | QDir::NoDotAndDotDot).isEmpty()) {
+        return false;
+    }
+
+    const QList<pid_t> members = cgroupProcesses(path);
+    if (members.isEmpty()) {
+        return false;
+    }
+    for (pid_t pid : members) {
+        if (!tree.contains(pid)) {
+            return false;
+        }
+    }
+
+    return access(QFile::encodeName(path + "/cgroup.freeze").constData(), W_OK) == 0;
+}
+
+bool CgroupFreezer::freeze(const QString& appPath, const QList<pid_t>& pids)
+{
+    if (!isAvailable() || pids.isEmpty()) {
+        return false;
+    }
+
+    auto it = m_frozenGroups.find(appPath);
+    if (it == m_frozenGroups.end()) {
+        it = m_frozenGroups.insert(appPath, FrozenGroup{QStringList(), QString(), QHash<pid_t, QString>(), false});
+    }
+
+    const QList<pid_t> processes = collectProcessTree(pids);
+    const QSet<pid_t> tree(processes.begin(), processes.end());
+    const QString ownGroup = it->path.isEmpty() ? QString() : it->path.mid(m_mountPath.size());
+
+    QMap<QString, QList<pid_t>> byCgroup;
+    for (pid_t pid : processes) {
+        const QString cgroup = processCgroup(pid);
+        if (!cgroup.isEmpty() && cgroup != ownGroup) {
+            byCgroup[cgroup].append(pid);
+        }
+    }
+
+    int moved = 0;
+    for (auto cgroupIt = byCgroup.constBegin(); cgroupIt != byCgroup.constEnd(); ++cgroupIt) {
+        const QString& cgroup = cgroupIt.key();
+        if (isOwnCgroup(cgroup, tree)) {
+            if (!it->inPlace.contains(m_mountPath + cgroup)) {
+                it->inPlace.append(m_mountPath + cgroup);
+            }
+            continue;
+        }
+
+        // Shared with other processes, so only the app's processes move out
+        const QString root = managerRoot(cgroup);
+        if (root.isEmpty() || !(root == m_rootPath || root.startsWith(m_rootPath + "/"))) {
+            logToFileCF("Cannot freeze processes of " + appPath + " in " + cgroup);
+            continue;
+        }
+
+        if (it->path.isEmpty()) {
+            const QString path = root + "/" + kSliceName + "/" + groupName(appPath);
+            if (!QDir().mkpath(path)) {
+                logToFileCF("Failed to create cgroup " + path);
+                continue;
+            }
+            it->path = path;
+        } else if (!it->path.startsWith(root + "/")) {
+            logToFileCF("Cannot freeze processes of " + appPath + " in " + cgroup);
+            continue;
+        }
+
+        for (pid_t pid : cgroupIt.value()) {
+            if (moveProcess(it->path, pid)) {
+                it->originalCgroups.insert(pid, cgroup);
+                moved++;
+            }
+        }
+    }
+
+    if (it->inPlace.isEmpty() && it->path.isEmpty()) {
+        m_frozenGroups.erase(it);
+        return false;
+    }
+
+    // Processes moved into an already frozen group freeze on arrival
+    QStringList groups = it->inPlace;
+    if (!it->path.isEmpty()) {
+        groups.append(it->path);
+    }
+    for (const QString& group : groups) {
+        if (!writeFile(group + "/cgroup.freeze", "1")) {
+            logToFileCF("Failed to freeze " + group);
+            thaw(appPath);
+            return false;
+        }
+    }
+    it->frozen = true;
+
+    logToFileCF(QString("Froze %1 (%2 cgroup(s) in place, %3 process(es) moved)")
+                    .arg(appPath).arg(it->inPlace.size()).arg(moved));
+    return true;
+}
+
+bool CgroupFreezer::thaw(const QString& appPath)
+{
+    auto it = m_frozenGroups.find(appPath);
+    if (it == m_frozenGroups.end()) {
+        return false;
+    }
+
+    // The app may have exited and systemd removed its scope meanwhile
+    for (const QString& scope : std::as_const(it->inPlace)) {
+        if (QFile::exists(scope) && !writeFile(scope + "/cgroup.freeze", "0")) {
+            logToFileCF("Failed to thaw " + scope);
+        }
+    }
+    it->inPlace.clear();
+
+    if (!it->path.isEmpty()) {
+        if (!writeFile(it->path + "/cgroup.freeze", "0")) {
+            logToFileCF("Failed to thaw " + it->path);
+        }
+
+        // Children forked before the freeze took effect are not in the map;
+        // they follow whichever original cgroup came first
+        const QString fallback = it->originalCgroups.isEmpty()
+                                     ? QString() : it->originalCgroups.constBegin().value();
+
+        for (pid_t pid : cgroupProcesses(it->path)) {
+            QString original = it->originalCgroups.value(pid, fallback);
+            if (original.isEmpty() || !moveProcess(m_mountPath + original, pid)) {
+                logToFileCF(QString("Could not move %1 back out of %2").arg(pid).arg(it->path));
+            }
+        }
+
+        // Keep what could not go back tracked; the next thaw retries and
+        // removes the group once its processes have moved or exited
+        const int remaining = int(cgroupProcesses(it->path).size());
+        if (remaining > 0) {
+            logToFileCF(QString("Keeping %1 with %2 process(es) that could not be moved back")
+                            .arg(it->path).arg(remaining));
+            it->frozen = false;
+            return true;
+        }
+
+        if (!QDir().rmdir(it->path)) {
+            logToFileCF("Failed to remove cgroup " + it->path);
+        }
+    }
+
+    m_frozenGroups.erase(it);
+    logToFileCF("Thawed " + appPath);
+    return true;
+}
+
+void CgroupFreezer::thawAll()
+{
+    const QStringList appPaths = m_frozenGroups.keys();
+    for (const QString& appPath : appPaths) {
+        thaw(appPath);
+    }
+}
+
+bool CgroupFreezer::isFrozen(const QString& appPath) const
+{
+    auto it = m_frozenGroups.constFind(appPath);
+    return it != m_frozenGroups.constEnd() && it->frozen;
+}
+
+QList<pid_t> CgroupFreezer::collectProcessTree(const QList<pid_t>& pids) const
+{
+    QMultiHash<pid_t, pid_t> children;
+
+    DIR* procDir = opendir("/proc");
+    if (procDir) {
+        struct dirent* entry;
+        while ((entry = readdir(procDir)) != nullptr) {
+            pid_t pid = atoi(entry->d_name);
+            if (pid <= 0) {
+                continue;
+            }
+
+            QFile statFile(QString("/proc/%1/stat").arg(pid));
+            if (!statFile.open(QIODevice::ReadOnly)) {
+                continue;
+            }
+            const QByteArray stat = statFile.readAll();
+            statFile.close();
+
+            // comm may contain spaces and parentheses; fields resume after the last ')'
+            int commEnd = stat.lastIndexOf(')');
+            if (commEnd < 0) {
+                continue;
+            }
+            const QList<QByteArray> fields = stat.mid(commEnd + 2).split(' ');
+            if (fields.size() > 1) {
+                children.insert(fields[1].toInt(), pid);
+            }
+        }
+        closedir(procDir);
+    }
+
+    QList<pid_t> tree;
+    QList<pid_t> queue = pids;
+    QSet<pid_t> seen;
+    while (!queue.isEmpty()) {
+        pid_t pid = queue.takeFirst();
+        if (seen.contains(pid)) {
+            continue;
+        }
+        seen.insert(pid);
+        tree.append(pid);
+        queue.append(children.values(pid));
+    }
+
+    return tree;
+}
+
+QList<pid_t> CgroupFreezer::cgroupProcesses(const QString& path) const
+{
+    QList<pid_t> pids;
+
+    QFile procsFile(path + "/cgroup.procs");
+    if (!procsFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return pids;
+    }
+
+    const QList<QByteArray> lines = procsFile.readAll().split('\n');
+    procsFile.close();
+
+    for (const QByteArray& line : lines) {
+        bool ok = false;
+        pid_t pid = line.trimmed().toInt(&ok);
+        if (ok) {
+            pids.append(pid);
+        }
+    }
+
+    return pids;
+}
+
+QString CgroupFreezer::processCgroup(pid_t pid) const
+{
+    QFile cgroupFile(QString("/proc/%1/cgroup").arg(pid));
+    if (!cgroupFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return QString();
+    }
+
+    // The unified hierarchy is the "0::" entry
+    const QList<QByteArray> lines = cgroupFile.readAll().split('\n');
+    cgroupFile.close();
+
+    for (const QByteArray& line : lines) {
+        if (line.startsWith("0::")) {
+            return QString::fromUtf8(line.mid(3));
+        }
+    }
+
+    return QString();
+}
+
+bool CgroupFreezer::moveProcess(const QString& cgroupPath, pid_t pid) const
+{
+    if (!writeFile(cgroupPath + "/cgroup.procs", QByteArray::number(pid))) {
+        logToFileCF(QString("Failed to move %1 into %2").arg(pid).arg(cgroupPath));
+        return false;
+    }
+
+    return true;
+}
+
+bool CgroupFreezer::writeFile(const QString& path, const QByteArray& value) const
+{
+    // cgroupfs reports errors from the write itself, so it must not be buffered
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+
+    bool ok = file.write(value) == value.size();
+    file.close();
+    return ok;
+}
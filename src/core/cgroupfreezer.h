@@ -0,0 +1,59 @@
+#pragma once
+#ifndef CGROUPFREEZER_H
+#define CGROUPFREEZER_H
+
+#include "../../include/Common.h"
+
+// Freezes blocked apps with the cgroup v2 freezer, so they stop being
+// scheduled entirely. A cgroup that holds nothing but the app, such as the
+// app-*.scope a desktop launches it in, is frozen in place. Processes that
+// share their cgroup with others are moved into
+// <user manager>/foccuss.slice/<app> and frozen there; thawing moves them
+// back. If a process cannot go back, because systemd removed its emptied
+// scope, the group is kept and tracked until it is empty.
+class CgroupFreezer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CgroupFreezer(QObject *parent = nullptr);
+    ~CgroupFreezer();
+
+    bool isAvailable() const;
+
+    bool freeze(const QString& appPath, const QList<pid_t>& pids);
+    bool thaw(const QString& appPath);
+    void thawAll();
+    bool isFrozen(const QString& appPath) const;
+
+private:
+    QString findDelegatedRoot() const;
+    static QString groupName(const QString& appPath);
+    QString managerRoot(const QString& cgroup) const;
+    bool isOwnCgroup(const QString& cgroup, const QSet<pid_t>& tree) const;
+    QList<pid_t> collectProcessTree(const QList<pid_t>& pids) const;
+    QList<pid_t> cgroupProcesses(const QString& path) const;
+    QString processCgroup(pid_t pid) const;
+    bool writeFile(const QString& path, const QByteArray& value) const;
+    bool moveProcess(const QString& cgroupPath, pid_t pid) const;
+
+    struct FrozenGroup
+    {
+        // The app's own cgroups, frozen where they are; never removed by us
+        QStringList inPlace;
+        // Our group for processes moved out of shared cgroups; empty if none
+        QString path;
+        // Cgroup each moved process came from, relative to the mount point
+        QHash<pid_t, QString> originalCgroups;
+        // False once thawed while processes that could not go back remain
+        bool frozen;
+    };
+
+    QString m_mountPath;
+    // Subtree this process may change: the delegated user manager, or the
+    // whole hierarchy as root
+    QString m_rootPath;
+    QHash<QString, FrozenGroup> m_frozenGroups;
+};
+
+#endif // CGROUPFREEZER_H
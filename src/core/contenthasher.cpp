@@ -0,0 +1,111 @@
+#include "contenthasher.h"
+
+static const char* const kRulePrefix = "xxh3:";
+// Digests of binaries that are no longer running are dropped wholesale
+static const int kMaxCachedDigests = 4096;
+
+bool ContentHasher::isAvailable()
+{
+#ifdef FOCCUSS_HAVE_XXHASH
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ContentHasher::fileKey(const char* path, FileKey* key)
+{
+    struct statx stx;
+    const unsigned int mask = STATX_INO | STATX_MTIME | STATX_SIZE;
+    if (statx(AT_FDCWD, path, 0, mask, &stx) != 0 || (stx.stx_mask & mask) != mask)
+        return false;
+
+    key->dev = (quint64(stx.stx_dev_major) << 32) | stx.stx_dev_minor;
+    key->ino = stx.stx_ino;
+    key->mtimeNs = qint64(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+    key->size = stx.stx_size;
+    return true;
+}
+
+bool ContentHasher::hash(const char* path, const FileKey& key, quint64* digest)
+{
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        auto it = m_cache.constFind(key);
+        if (it != m_cache.constEnd()) {
+            *digest = it.value();
+            return true;
+        }
+    }
+
+    // Hashed unlocked; two threads meeting the same new binary both hash it
+    if (!hashFile(path, digest))
+        return false;
+
+    QMutexLocker locker(&m_cacheMutex);
+    if (m_cache.size() >= kMaxCachedDigests) {
+        m_cache.clear();
+    }
+    m_cache.insert(key, *digest);
+    return true;
+}
+
+bool ContentHasher::hashFile(const char* path, quint64* digest)
+{
+#ifdef FOCCUSS_HAVE_XXHASH
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        ::close(fd);
+        *digest = XXH3_64bits(nullptr, 0);
+        return true;
+    }
+
+    void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    // One sequential pass over the whole file
+    madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);
+    *digest = XXH3_64bits(data, size_t(st.st_size));
+
+    munmap(data, size_t(st.st_size));
+    return true;
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(digest);
+    return false;
+#endif
+}
+
+QString ContentHasher::toRulePath(quint64 size, quint64 digest)
+{
+    return QString(kRulePrefix) + QString::number(size) + ':' + QString("%1").arg(digest, 16, 16, QChar('0'));
+}
+
+bool ContentHasher::fromRulePath(const QString& rulePath, quint64* size, quint64* digest)
+{
+    if (!rulePath.startsWith(kRulePrefix))
+        return false;
+
+    const QStringList fields = rulePath.mid(int(strlen(kRulePrefix))).split(':');
+    if (fields.size() > 2)
+        return false;
+
+    bool ok = true;
+    *size = fields.size() == 2 ? fields.first().toULongLong(&ok) : 0;
+    if (!ok)
+        return false;
+
+    *digest = fields.last().toULongLong(&ok, 16);
+    return ok;
+}
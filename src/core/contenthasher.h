@@ -0,0 +1,53 @@
+#pragma once
+#ifndef CONTENTHASHER_H
+#define CONTENTHASHER_H
+
+#include "../../include/Common.h"
+
+// XXH3 digests of executables, for rules that follow a binary when it is
+// copied or renamed. Files are memory-mapped and hashed once; the digest is
+// cached under (dev, ino, mtime, size) so it is recomputed only when the
+// file changes. Only built in when libxxhash is available. hash() may be
+// called from several scan threads at once.
+class ContentHasher
+{
+public:
+    struct FileKey
+    {
+        quint64 dev;
+        quint64 ino;
+        qint64 mtimeNs;
+        quint64 size;
+
+        bool operator==(const FileKey& other) const
+        {
+            return dev == other.dev && ino == other.ino && mtimeNs == other.mtimeNs && size == other.size;
+        }
+    };
+
+    static bool isAvailable();
+
+    // One statx; follows symlinks, so /proc/N/exe gives the running binary
+    static bool fileKey(const char* path, FileKey* key);
+
+    bool hash(const char* path, const FileKey& key, quint64* digest);
+
+    // Rule path form of a file size and digest, e.g. "xxh3:48213:0123456789abcdef".
+    // The size lets a scan skip hashing every binary that cannot match; rules
+    // from before it was stored ("xxh3:<digest>") give a size of 0.
+    static QString toRulePath(quint64 size, quint64 digest);
+    static bool fromRulePath(const QString& rulePath, quint64* size, quint64* digest);
+
+private:
+    static bool hashFile(const char* path, quint64* digest);
+
+    QMutex m_cacheMutex;
+    QHash<FileKey, quint64> m_cache;
+};
+
+inline size_t qHash(const ContentHasher::FileKey& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.dev, key.ino, key.mtimeNs, key.size);
+}
+
+#endif // CONTENTHASHER_H
@@ -0,0 +1,182 @@
+#include "patternset.h"
+
+void PatternSet::clear()
+{
+    m_patterns.clear();
+    m_literals.clear();
+    m_unfiltered.clear();
+    m_prefilter.build(QStringList());
+}
+
+bool PatternSet::add(const QString& pattern, QString* error)
+{
+    QRegularExpression regex(pattern);
+    if (!regex.isValid()) {
+        if (error) {
+            *error = regex.errorString();
+        }
+        return false;
+    }
+    // Compiles and JITs now rather than on the first scan thread to match
+    regex.optimize();
+
+    const QString literal = requiredLiteral(pattern);
+    if (literal.isEmpty()) {
+        m_unfiltered.push_back(int(m_patterns.size()));
+    }
+
+    m_patterns.append(regex);
+    m_literals.append(literal);
+    return true;
+}
+
+void PatternSet::build()
+{
+    // Empty literals are skipped, so keyword indices are pattern indices
+    m_prefilter.build(m_literals);
+}
+
+bool PatternSet::isEmpty() const
+{
+    return m_patterns.isEmpty();
+}
+
+int PatternSet::findFirst(const QString& text) const
+{
+    // The prefilter folds case, so it may let through a few patterns that
+    // then fail, but never drops one that would match
+    std::vector<int> candidates = m_prefilter.findAll(text);
+    if (!m_unfiltered.empty()) {
+        candidates.insert(candidates.end(), m_unfiltered.begin(), m_unfiltered.end());
+        std::sort(candidates.begin(), candidates.end());
+    }
+
+    for (int index : candidates) {
+        if (m_patterns.at(index).match(text).hasMatch())
+            return index;
+    }
+
+    return -1;
+}
+
+QString PatternSet::requiredLiteral(const QString& regex)
+{
+    // In extended mode whitespace and '#' comments are not literals
+    static const QRegularExpression extendedOption("\\(\\?[a-zA-Z^-]*x");
+    if (regex.contains(extendedOption))
+        return QString();
+
+    // Only plain characters outside any group count, and only when the top
+    // level has no alternation: then each of them is in every match, in order
+    QString best;
+    QString run;
+    int depth = 0;
+
+    auto endRun = [&]() {
+        if (run.size() > best.size()) {
+            best = run;
+        }
+        run.clear();
+    };
+
+    for (int i = 0; i < regex.size(); ++i) {
+        const QChar c = regex.at(i);
+
+        if (c == '\\') {
+            if (i + 1 >= regex.size())
+                break;
+
+            const QChar escaped = regex.at(++i);
+            const bool isAsciiAlnum = escaped.unicode() < 128 && escaped.isLetterOrNumber();
+            if (!isAsciiAlnum) {
+                // An escaped punctuation character stands for itself
+                if (depth == 0) {
+                    run += escaped;
+                }
+                continue;
+            }
+
+            // Classes, anchors, backreferences and the like; skip their arguments
+            endRun();
+            const QChar next = i + 1 < regex.size() ? regex.at(i + 1) : QChar();
+            if (escaped == 'Q') {
+                i = regex.indexOf("\\E", i + 1);
+                if (i < 0)
+                    break;
+                ++i;
+            } else if (next == '{' && QString("xopPNgk").contains(escaped)) {
+                i = regex.indexOf('}', i + 2);
+                if (i < 0)
+                    break;
+            } else if ((next == '<' || next == '\'') && (escaped == 'g' || escaped == 'k')) {
+                i = regex.indexOf(next == '<' ? QChar('>') : QChar('\''), i + 2);
+                if (i < 0)
+                    break;
+            } else if (escaped == 'c' || escaped == 'p' || escaped == 'P') {
+                ++i;
+            } else if (escaped == 'x') {
+                static const QString kHexDigits = "0123456789abcdefABCDEF";
+                for (int digits = 0; digits < 2 && i + 1 < regex.size()
+                     && kHexDigits.contains(regex.at(i + 1)); ++digits) {
+                    ++i;
+                }
+            } else if (escaped.isDigit()) {
+                while (i + 1 < regex.size() && regex.at(i + 1).isDigit())
+                    ++i;
+            }
+            continue;
+        }
+
+        if (c == '[') {
+            endRun();
+            int j = i + 1;
+            if (j < regex.size() && regex.at(j) == '^')
+                ++j;
+            if (j < regex.size() && regex.at(j) == ']')
+                ++j;
+            while (j < regex.size() && regex.at(j) != ']') {
+                if (regex.at(j) == '\\') {
+                    ++j;
+                } else if (regex.at(j) == '[' && j + 1 < regex.size() && regex.at(j + 1) == ':') {
+                    j = regex.indexOf(":]", j + 2);
+                    if (j < 0)
+                        break;
+                    ++j;
+                }
+                ++j;
+            }
+            if (j < 0 || j >= regex.size())
+                break;
+            i = j;
+            continue;
+        }
+
+        if (c == '(') {
+            endRun();
+            ++depth;
+        } else if (c == ')') {
+            --depth;
+        } else if (c == '|') {
+            if (depth == 0)
+                return QString();
+        } else if (c == '?' || c == '*' || c == '{') {
+            // The quantified character may be absent
+            if (!run.isEmpty()) {
+                run.chop(run.size() > 1 && run.back().isLowSurrogate() ? 2 : 1);
+            }
+            endRun();
+            if (c == '{') {
+                i = regex.indexOf('}', i + 1);
+                if (i < 0)
+                    break;
+            }
+        } else if (c == '+' || c == '.' || c == '^' || c == '$') {
+            endRun();
+        } else if (depth == 0) {
+            run += c;
+        }
+    }
+
+    endRun();
+    return best;
+}
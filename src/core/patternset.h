@@ -0,0 +1,40 @@
+#pragma once
+#ifndef PATTERNSET_H
+#define PATTERNSET_H
+
+#include "../../include/Common.h"
+#include "ahocorasick.h"
+
+// Regular expressions matched together behind a literal prefilter. Each
+// pattern is compiled on its own, so its groups, backreferences and errors
+// stay its own, and is filed under the longest literal every match of it
+// contains. One Aho-Corasick pass over a text finds the patterns whose
+// literal occurs and only those are run; patterns without such a literal
+// are run on every text. findFirst() may be called from several threads.
+class PatternSet
+{
+public:
+    void clear();
+
+    // False, with the compile error in error, if the pattern is invalid
+    bool add(const QString& pattern, QString* error);
+    // Call once after the last add()
+    void build();
+    bool isEmpty() const;
+
+    // Index, in add() order, of the first pattern matching text, or -1
+    int findFirst(const QString& text) const;
+
+    // Longest run of characters that every match of regex contains, or an
+    // empty string when none can be told without running the regex
+    static QString requiredLiteral(const QString& regex);
+
+private:
+    QList<QRegularExpression> m_patterns;
+    // Parallel to m_patterns; empty when the pattern has no literal
+    QStringList m_literals;
+    std::vector<int> m_unfiltered;
+    AhoCorasick m_prefilter;
+};
+
+#endif // PATTERNSET_H
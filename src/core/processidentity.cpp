@@ -0,0 +1,199 @@
+#include "processidentity.h"
+
+// Reads a small /proc file into buf with a single read(2), NUL terminated
+static ssize_t readProcFile(const char* path, char* buf, size_t size)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ssize_t len = ::read(fd, buf, size - 1);
+    ::close(fd);
+
+    if (len < 0)
+        return -1;
+
+    buf[len] = '\0';
+    return len;
+}
+
+QString ProcessIdentity::resolve(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/exe", pid);
+    char exePath[PATH_MAX];
+    ssize_t len = readlink(path, exePath, sizeof(exePath) - 1);
+
+    if (len == -1)
+        return QString();
+
+    exePath[len] = '\0';
+
+    // Sandboxed children only differ from the host in their cgroup, which
+    // systemd names after the flatpak or snap they were started from
+    QString sandboxIdentity = fromCgroup(pid);
+    if (!sandboxIdentity.isEmpty())
+        return sandboxIdentity;
+
+    // Inside a flatpak the exe resolves in the sandbox mount namespace
+    if (strncmp(exePath, "/app/", 5) == 0) {
+        QString flatpakId = fromFlatpakInfo(pid);
+        if (!flatpakId.isEmpty())
+            return QString("flatpak run %1").arg(flatpakId);
+    }
+
+    QString processPath = QString::fromLocal8Bit(exePath, len);
+    if (processPath.startsWith("/snap/")) {
+        QFileInfo snapInfo(processPath);
+        QString snapName = snapInfo.fileName();
+        return QString("/snap/bin/%1").arg(snapName);
+    }
+
+    return processPath;
+}
+
+QString ProcessIdentity::fromCgroup(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+    char buf[4096];
+    if (readProcFile(path, buf, sizeof(buf)) <= 0)
+        return QString();
+
+    // cgroup v2 has a single "0::/path" line; on hybrid setups take the
+    // systemd hierarchy, which carries the same unit names
+    const char* line = strstr(buf, "0::/");
+    if (!line)
+        line = strstr(buf, ":name=systemd:/");
+    if (!line)
+        return QString();
+
+    const char* lineEnd = strchr(line, '\n');
+    if (!lineEnd)
+        lineEnd = line + strlen(line);
+
+    // The unit is the last path component, e.g. app-flatpak-org.foo.Bar-1234.scope
+    const char* unit = line;
+    for (const char* p = line; p < lineEnd; ++p) {
+        if (*p == '/')
+            unit = p + 1;
+    }
+    QByteArray unitName(unit, int(lineEnd - unit));
+
+    if (unitName.startsWith("app-flatpak-") && unitName.endsWith(".scope")) {
+        // Strip the prefix, ".scope" and the trailing "-<pid>" systemd adds
+        QByteArray id = unitName.mid(12, unitName.size() - 12 - 6);
+        int instanceSep = id.lastIndexOf('-');
+        if (instanceSep > 0)
+            id.truncate(instanceSep);
+        if (!id.isEmpty())
+            return QString("flatpak run %1").arg(QString::fromUtf8(id));
+    } else if (unitName.startsWith("snap.")) {
+        // snap.<snap>.<app>-<uuid>.scope or snap.<snap>.<app>.service
+        QList<QByteArray> parts = unitName.split('.');
+        if (parts.size() >= 3) {
+            QByteArray snapName = parts.at(1);
+            QByteArray appName = parts.at(2);
+            int uuidSep = appName.indexOf('-');
+            if (uuidSep > 0)
+                appName.truncate(uuidSep);
+            if (appName.isEmpty() || appName == snapName)
+                return QString("/snap/bin/%1").arg(QString::fromUtf8(snapName));
+            return QString("/snap/bin/%1.%2").arg(QString::fromUtf8(snapName), QString::fromUtf8(appName));
+        }
+    }
+
+    return QString();
+}
+
+QString ProcessIdentity::fromFlatpakInfo(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/root/.flatpak-info", pid);
+    char buf[4096];
+    if (readProcFile(path, buf, sizeof(buf)) <= 0)
+        return QString();
+
+    // name= inside the [Application] group of a keyfile
+    const char* group = strstr(buf, "[Application]");
+    if (!group)
+        return QString();
+
+    const char* key = strstr(group, "\nname=");
+    if (!key)
+        return QString();
+
+    key += 6;
+    const char* keyEnd = strchr(key, '\n');
+    int keyLen = keyEnd ? int(keyEnd - key) : int(strlen(key));
+    return QString::fromUtf8(key, keyLen).trimmed();
+}
+
+pid_t ProcessIdentity::parentPid(pid_t pid)
+{
+    pid_t parent = 0;
+    quint64 startTime = 0;
+    if (!readStat(pid, &parent, &startTime))
+        return 0;
+    return parent;
+}
+
+bool ProcessIdentity::readStat(pid_t pid, pid_t* parent, quint64* startTime)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    char buf[1024];
+    if (readProcFile(path, buf, sizeof(buf)) <= 0)
+        return false;
+
+    // comm is in parentheses and may itself contain spaces or ')'
+    const char* commEnd = strrchr(buf, ')');
+    if (!commEnd || commEnd[1] != ' ')
+        return false;
+
+    // Fields after comm start at state (3); ppid is 4, starttime is 22
+    const char* field = commEnd + 2;
+    for (int index = 3; index <= 22; ++index) {
+        if (index == 4)
+            *parent = pid_t(strtol(field, nullptr, 10));
+        if (index == 22) {
+            *startTime = strtoull(field, nullptr, 10);
+            return true;
+        }
+
+        field = strchr(field, ' ');
+        if (!field)
+            return false;
+        ++field;
+    }
+
+    return false;
+}
+
+ProcessRef ProcessIdentity::ref(pid_t pid)
+{
+    ProcessRef ref = { pid, 0 };
+    pid_t parent = 0;
+    readStat(pid, &parent, &ref.startTime);
+    return ref;
+}
+
+bool ProcessIdentity::isSameProcess(const ProcessRef& ref)
+{
+    if (ref.pid <= 0 || ref.startTime == 0)
+        return false;
+
+    pid_t parent = 0;
+    quint64 startTime = 0;
+    return readStat(ref.pid, &parent, &startTime) && startTime == ref.startTime;
+}
+
+QList<pid_t> ProcessIdentity::livePids(const QList<ProcessRef>& refs)
+{
+    QList<pid_t> pids;
+    for (const ProcessRef& ref : refs) {
+        if (isSameProcess(ref))
+            pids.append(ref.pid);
+    }
+    return pids;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef PROCESSIDENTITY_H
+#define PROCESSIDENTITY_H
+
+#include "../../include/Common.h"
+
+// A pid pinned to one process by its start time, so a pid the kernel hands
+// out again after the process exited is never mistaken for it
+struct ProcessRef
+{
+    pid_t pid;
+    quint64 startTime;
+};
+
+// Maps a running process to the application path used throughout Foccuss:
+// the executable itself, "flatpak run <id>" or "/snap/bin/<name>". Shared by
+// the block scan and the usage tracker so both agree on what an app is.
+// Sandboxes are recognised from the systemd unit in /proc/N/cgroup, which
+// every process of a flatpak or snap inherits, helpers included.
+class ProcessIdentity
+{
+public:
+    static QString resolve(pid_t pid);
+    // From the fourth field of /proc/N/stat, 0 when the process is gone
+    static pid_t parentPid(pid_t pid);
+    // Parent pid and start time (clock ticks since boot) in one read of
+    // /proc/N/stat; false when the process is gone
+    static bool readStat(pid_t pid, pid_t* parent, quint64* startTime);
+
+    // startTime is 0 when the process is gone
+    static ProcessRef ref(pid_t pid);
+    // True while ref.pid still belongs to the process it was taken from
+    static bool isSameProcess(const ProcessRef& ref);
+    static QList<pid_t> livePids(const QList<ProcessRef>& refs);
+
+private:
+    static QString fromCgroup(pid_t pid);
+    static QString fromFlatpakInfo(pid_t pid);
+};
+
+#endif // PROCESSIDENTITY_H
@@ -0,0 +1,183 @@
+#include "processterminator.h"
+
+static QString s_logFilePath;
+
+void logToFilePT(const QString& message)
+{
+    if (s_logFilePath.isEmpty()) {
+        QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir appDataDir(appDataPath);
+        if (!appDataDir.exists()) {
+            appDataDir.mkpath(".");
+        }
+        s_logFilePath = appDataDir.filePath("foccuss_service.log");
+    }
+
+    QFile logFile(s_logFilePath);
+    if (logFile.open(QIODevice::Append | QIODevice::Text)) {
+        QTextStream out(&logFile);
+        out << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
+            << " - " << message << "\n";
+        logFile.close();
+    }
+}
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+static int pidfdOpen(pid_t pid)
+{
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+static int pidfdSendSignal(int pidfd, int signalNumber)
+{
+    return static_cast<int>(syscall(SYS_pidfd_send_signal, pidfd, signalNumber, nullptr, 0));
+}
+
+ProcessTerminator::ProcessTerminator(QObject *parent)
+    : QObject(parent),
+      m_gracePeriod(3000)
+{
+}
+
+ProcessTerminator::~ProcessTerminator()
+{
+    for (const Termination& termination : std::as_const(m_pending)) {
+        if (termination.pidfd >= 0) {
+            ::close(termination.pidfd);
+        }
+    }
+    m_pending.clear();
+}
+
+void ProcessTerminator::setGracePeriod(int msecs)
+{
+    m_gracePeriod = qMax(0, msecs);
+}
+
+int ProcessTerminator::gracePeriod() const
+{
+    return m_gracePeriod;
+}
+
+void ProcessTerminator::terminate(const QList<ProcessRef>& processes)
+{
+    for (const ProcessRef& process : processes) {
+        const pid_t pid = process.pid;
+        if (pid <= 0 || pid == getpid() || m_pending.contains(pid)) {
+            continue;
+        }
+
+        Termination termination = { process, pidfdOpen(pid), nullptr, nullptr };
+        if (termination.pidfd < 0) {
+            if (errno == ESRCH) {
+                continue;
+            }
+            // Kernels before 5.3 have no pidfds; fall back to plain signals
+            logToFilePT(QString("pidfd_open(%1) failed: %2, falling back to kill()").arg(pid).arg(strerror(errno)));
+        }
+
+        // Checked once the pidfd pins the pid: if the start time still
+        // matches, the fd refers to the process that was detected
+        if (!ProcessIdentity::isSameProcess(process)) {
+            logToFilePT(QString("Process %1 exited before it could be terminated").arg(pid));
+            if (termination.pidfd >= 0) {
+                ::close(termination.pidfd);
+            }
+            continue;
+        }
+
+        if (!sendSignal(termination, SIGTERM)) {
+            if (errno != ESRCH) {
+                logToFilePT(QString("Failed to send SIGTERM to %1: %2").arg(pid).arg(strerror(errno)));
+            }
+            if (termination.pidfd >= 0) {
+                ::close(termination.pidfd);
+            }
+            continue;
+        }
+
+        // A pidfd becomes readable once the process has exited
+        if (termination.pidfd >= 0) {
+            termination.notifier = new QSocketNotifier(termination.pidfd, QSocketNotifier::Read, this);
+            connect(termination.notifier, &QSocketNotifier::activated, this, [this, pid]() {
+                onProcessExited(pid);
+            });
+        }
+
+        termination.graceTimer = new QTimer(this);
+        termination.graceTimer->setSingleShot(true);
+        connect(termination.graceTimer, &QTimer::timeout, this, [this, pid]() {
+            onGracePeriodExpired(pid);
+        });
+        termination.graceTimer->start(m_gracePeriod);
+
+        m_pending.insert(pid, termination);
+    }
+}
+
+bool ProcessTerminator::sendSignal(const Termination& termination, int signalNumber) const
+{
+    if (termination.pidfd >= 0) {
+        return pidfdSendSignal(termination.pidfd, signalNumber) == 0;
+    }
+
+    // Without a pidfd the check and kill() can still race, but only briefly
+    if (!ProcessIdentity::isSameProcess(termination.process)) {
+        errno = ESRCH;
+        return false;
+    }
+    return kill(termination.process.pid, signalNumber) == 0;
+}
+
+void ProcessTerminator::onProcessExited(pid_t pid)
+{
+    finish(pid, false);
+}
+
+void ProcessTerminator::onGracePeriodExpired(pid_t pid)
+{
+    auto it = m_pending.constFind(pid);
+    if (it == m_pending.constEnd()) {
+        return;
+    }
+
+    if (sendSignal(*it, SIGKILL)) {
+        logToFilePT(QString("Process %1 ignored SIGTERM, sent SIGKILL").arg(pid));
+        finish(pid, true);
+    } else {
+        // Already gone, the exit just raced the timer
+        finish(pid, false);
+    }
+}
+
+void ProcessTerminator::finish(pid_t pid, bool forced)
+{
+    auto it = m_pending.find(pid);
+    if (it == m_pending.end()) {
+        return;
+    }
+
+    Termination termination = it.value();
+    m_pending.erase(it);
+
+    if (termination.notifier) {
+        termination.notifier->setEnabled(false);
+        termination.notifier->deleteLater();
+    }
+    if (termination.graceTimer) {
+        termination.graceTimer->stop();
+        termination.graceTimer->deleteLater();
+    }
+    if (termination.pidfd >= 0) {
+        ::close(termination.pidfd);
+    }
+
+    emit processTerminated(pid, forced);
+}
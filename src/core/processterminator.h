@@ -0,0 +1,47 @@
+#pragma once
+#ifndef PROCESSTERMINATOR_H
+#define PROCESSTERMINATOR_H
+
+#include "../../include/Common.h"
+#include "processidentity.h"
+
+// Terminates exact processes through pidfds: SIGTERM first, then SIGKILL
+// for anything still alive once the grace period runs out. A process is
+// only signalled if its pid still carries the start time seen at detection,
+// checked after the pidfd is open, so a reused pid is never hit. Exits are
+// observed by polling the pidfds from the event loop, so nothing blocks.
+class ProcessTerminator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProcessTerminator(QObject *parent = nullptr);
+    ~ProcessTerminator();
+
+    void setGracePeriod(int msecs);
+    int gracePeriod() const;
+
+    void terminate(const QList<ProcessRef>& processes);
+
+signals:
+    void processTerminated(pid_t pid, bool forced);
+
+private:
+    struct Termination
+    {
+        ProcessRef process;
+        int pidfd;
+        QSocketNotifier *notifier;
+        QTimer *graceTimer;
+    };
+
+    void onProcessExited(pid_t pid);
+    void onGracePeriodExpired(pid_t pid);
+    void finish(pid_t pid, bool forced);
+    bool sendSignal(const Termination& termination, int signalNumber) const;
+
+    int m_gracePeriod;
+    QHash<pid_t, Termination> m_pending;
+};
+
+#endif // PROCESSTERMINATOR_H
@@ -0,0 +1,333 @@
+#include "ruleindex.h"
+#include "processidentity.h"
+#include "../data/database.h"
+#include "../data/appmodel.h"
+
+static QString s_logFilePath;
+
+void logToFileRI(const QString& message)
+{
+    if (s_logFilePath.isEmpty()) {
+        QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir appDataDir(appDataPath);
+        if (!appDataDir.exists()) {
+            appDataDir.mkpath(".");
+        }
+        s_logFilePath = appDataDir.filePath("foccuss_service.log");
+    }
+
+    QFile logFile(s_logFilePath);
+    if (logFile.open(QIODevice::Append | QIODevice::Text)) {
+        QTextStream out(&logFile);
+        out << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
+            << " - " << message << "\n";
+        logFile.close();
+    }
+}
+
+RuleIndex::RuleIndex(Database* database, QObject *parent)
+    : QObject(parent),
+      m_database(database),
+      m_revision(-1),
+      m_dirty(true),
+      m_hashAnySize(false)
+{
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &RuleIndex::onExecutableChanged);
+}
+
+void RuleIndex::refresh()
+{
+    if (!m_database || !m_database->isInitialized())
+        return;
+
+    qint64 revision = m_database->rulesRevision();
+    if (!m_dirty && revision == m_revision)
+        return;
+
+    m_revision = revision;
+    m_dirty = false;
+    rebuild();
+}
+
+bool RuleIndex::isEmpty() const
+{
+    return m_inodes.isEmpty() && m_contentDigests.isEmpty() && m_cmdlineNeedles.isEmpty()
+        && m_missingPaths.isEmpty() && m_patterns.isEmpty();
+}
+
+void RuleIndex::onExecutableChanged(const QString& path)
+{
+    logToFileRI("Blocked executable changed, re-resolving rules: " + path);
+    m_dirty = true;
+}
+
+void RuleIndex::rebuild()
+{
+    // Processes started before an update keep running the old inode, so
+    // keys of replaced binaries are retired rather than dropped, and
+    // pruneRetired() forgets them once nothing runs them any more
+    QHash<InodeKey, InodeRule> previous = m_retiredInodes;
+    previous.insert(m_inodes);
+
+    m_inodes.clear();
+    m_retiredInodes.clear();
+    m_contentDigests.clear();
+    m_contentSizes.clear();
+    m_hashAnySize = false;
+    m_cmdlineNeedles.clear();
+    m_missingPaths.clear();
+    m_patternRules.clear();
+    m_patterns.clear();
+
+    if (!m_watcher.files().isEmpty()) {
+        m_watcher.removePaths(m_watcher.files());
+    }
+
+    QSet<QString> rulePaths;
+    for (const auto& app : m_database->getBlockedApps()) {
+        const QString rulePath = app->getPath();
+        if (rulePath.isEmpty() || rulePath.contains("foccuss"))
+            continue;
+
+        rulePaths.insert(rulePath);
+
+        quint64 size = 0;
+        quint64 digest = 0;
+        if (ContentHasher::fromRulePath(rulePath, &size, &digest)) {
+            if (ContentHasher::isAvailable()) {
+                m_contentDigests.insert(digest, rulePath);
+                if (size > 0) {
+                    m_contentSizes.insert(size);
+                } else {
+                    // Sizeless rule from an older version; every binary has to be hashed
+                    m_hashAnySize = true;
+                }
+            } else {
+                logToFileRI("Built without xxHash, ignoring content rule " + rulePath);
+            }
+            continue;
+        }
+
+        // Sandboxed apps keep their historical loose forms: any flatpak
+        // command naming the ID, any snap command ending in the name
+        if (rulePath.startsWith("flatpak run ")) {
+            addPattern(rulePath, "\\Aflatpak run .*" + QRegularExpression::escape(rulePath.mid(12)) + ".*\\z");
+            continue;
+        }
+        if (rulePath.startsWith("/snap/bin/")) {
+            addPattern(rulePath, "\\A/snap/bin/.*" + QRegularExpression::escape(rulePath.mid(10)) + "\\z");
+            continue;
+        }
+
+        ContentHasher::FileKey fileKey;
+        if (ContentHasher::fileKey(QFile::encodeName(rulePath).constData(), &fileKey)) {
+            m_inodes.insert(InodeKey(fileKey.dev, fileKey.ino), InodeRule{rulePath, fileKey.mtimeNs, fileKey.size});
+            m_watcher.addPath(rulePath);
+        } else {
+            // Not installed yet; match the path literally until it appears
+            m_missingPaths.insert(rulePath, rulePath);
+        }
+    }
+
+    for (const QString& pattern : m_database->getBlockRules("glob")) {
+        if (pattern.isEmpty() || pattern.contains("foccuss"))
+            continue;
+
+        addPattern("glob:" + pattern, "\\A" + globToRegex(pattern) + "\\z");
+    }
+
+    for (const QString& pattern : m_database->getBlockRules("regex")) {
+        if (pattern.isEmpty() || pattern.contains("foccuss"))
+            continue;
+
+        // Regex rules search the path rather than match all of it, and are
+        // compiled as written so their groups and backreferences keep working
+        addPattern("regex:" + pattern, pattern);
+    }
+
+    m_patterns.build();
+
+    for (const QString& pattern : m_database->getBlockRules("cmdline")) {
+        if (pattern.isEmpty() || pattern.contains("foccuss"))
+            continue;
+
+        // Arguments are NUL-separated in /proc/N/cmdline; a space in the
+        // rule stands for an argument boundary
+        QByteArray needle = pattern.toUtf8();
+        needle.replace(' ', '\0');
+        m_cmdlineNeedles.append(qMakePair(needle, "cmdline:" + pattern));
+    }
+
+    for (auto it = previous.constBegin(); it != previous.constEnd(); ++it) {
+        if (rulePaths.contains(it.value().rulePath) && !m_inodes.contains(it.key())) {
+            m_retiredInodes.insert(it.key(), it.value());
+        }
+    }
+}
+
+void RuleIndex::pruneRetired()
+{
+    QMutexLocker locker(&m_retiredMutex);
+    for (auto it = m_retiredInodes.begin(); it != m_retiredInodes.end();) {
+        if (m_retiredSeen.contains(it.key())) {
+            ++it;
+        } else {
+            logToFileRI("Forgetting replaced binary of " + it.value().rulePath);
+            it = m_retiredInodes.erase(it);
+        }
+    }
+    m_retiredSeen.clear();
+}
+
+QString RuleIndex::match(pid_t pid, std::vector<char>& cmdlineBuffer) const
+{
+    if (pid == getpid())
+        return QString();
+
+    char exeLink[64];
+    snprintf(exeLink, sizeof(exeLink), "/proc/%d/exe", pid);
+
+    // Fails for kernel threads and processes we may not inspect
+    ContentHasher::FileKey fileKey;
+    if (!ContentHasher::fileKey(exeLink, &fileKey))
+        return QString();
+
+    const InodeKey inodeKey(fileKey.dev, fileKey.ino);
+    auto it = m_inodes.constFind(inodeKey);
+    if (it != m_inodes.constEnd())
+        return it.value().rulePath;
+
+    auto retiredIt = m_retiredInodes.constFind(inodeKey);
+    if (retiredIt != m_retiredInodes.constEnd() && retiredIt.value().mtimeNs == fileKey.mtimeNs
+        && retiredIt.value().size == fileKey.size) {
+        // Rare, so a lock shared by the scan threads costs nothing
+        QMutexLocker locker(&m_retiredMutex);
+        m_retiredSeen.insert(inodeKey);
+        return retiredIt.value().rulePath;
+    }
+
+    // Only binaries exactly as large as some content rule are worth hashing
+    quint64 digest = 0;
+    if ((m_hashAnySize || m_contentSizes.contains(fileKey.size))
+        && m_hasher.hash(exeLink, fileKey, &digest)) {
+        auto digestIt = m_contentDigests.constFind(digest);
+        if (digestIt != m_contentDigests.constEnd())
+            return digestIt.value();
+    }
+
+    if (!m_cmdlineNeedles.isEmpty()) {
+        QString rulePath = matchCmdline(pid, cmdlineBuffer);
+        if (!rulePath.isEmpty())
+            return rulePath;
+    }
+
+    if (m_missingPaths.isEmpty() && m_patterns.isEmpty())
+        return QString();
+
+    const QString processPath = ProcessIdentity::resolve(pid);
+    if (processPath.isEmpty() || processPath.contains("foccuss"))
+        return QString();
+
+    auto missingIt = m_missingPaths.constFind(processPath);
+    if (missingIt != m_missingPaths.constEnd())
+        return missingIt.value();
+
+    const int index = m_patterns.findFirst(processPath);
+    return index >= 0 ? m_patternRules.at(index) : QString();
+}
+
+void RuleIndex::addPattern(const QString& rulePath, const QString& regex)
+{
+    // A rule that does not compile is dropped on its own; the others still apply
+    QString error;
+    if (!m_patterns.add(regex, &error)) {
+        logToFileRI("Ignoring invalid rule " + rulePath + ": " + error);
+        return;
+    }
+    m_patternRules.append(rulePath);
+}
+
+QString RuleIndex::globToRegex(const QString& glob)
+{
+    // '*' and '**' both cross directories, so "*/steam*" matches at any depth
+    QString regex;
+    for (int i = 0; i < glob.size(); ++i) {
+        const QChar c = glob.at(i);
+        if (c == '*') {
+            while (i + 1 < glob.size() && glob.at(i + 1) == '*')
+                ++i;
+            regex += ".*";
+        } else if (c == '?') {
+            regex += '.';
+        } else if (c == '[') {
+            int close = glob.indexOf(']', i + 2);
+            if (close < 0) {
+                regex += "\\[";
+                continue;
+            }
+            QString set = glob.mid(i + 1, close - i - 1);
+            if (set.startsWith('!'))
+                set[0] = '^';
+            regex += '[' + set.replace("\\", "\\\\") + ']';
+            i = close;
+        } else {
+            regex += QRegularExpression::escape(QString(c));
+        }
+    }
+    return regex;
+}
+
+// Candidates are found with memchr, which glibc implements with SIMD
+// loads, so most of the buffer is skipped without a per-byte loop
+static bool containsBytes(const char* haystack, size_t length, const QByteArray& needle)
+{
+    const size_t needleLength = size_t(needle.size());
+    if (needleLength == 0 || needleLength > length)
+        return false;
+
+    const char first = needle.at(0);
+    const char* cursor = haystack;
+    const char* last = haystack + (length - needleLength);
+
+    while (cursor <= last) {
+        cursor = static_cast<const char*>(memchr(cursor, first, size_t(last - cursor) + 1));
+        if (!cursor)
+            return false;
+        if (memcmp(cursor + 1, needle.constData() + 1, needleLength - 1) == 0)
+            return true;
+        ++cursor;
+    }
+
+    return false;
+}
+
+QString RuleIndex::matchCmdline(pid_t pid, std::vector<char>& buffer) const
+{
+    // Longer command lines are cut off; rules are about the leading arguments
+    static const size_t kMaxCmdline = 64 * 1024;
+    if (buffer.size() < kMaxCmdline) {
+        buffer.resize(kMaxCmdline);
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return QString();
+
+    size_t length = 0;
+    while (length < buffer.size()) {
+        ssize_t chunk = ::read(fd, buffer.data() + length, buffer.size() - length);
+        if (chunk <= 0)
+            break;
+        length += size_t(chunk);
+    }
+    ::close(fd);
+
+    for (const auto& needle : std::as_const(m_cmdlineNeedles)) {
+        if (containsBytes(buffer.data(), length, needle.first))
+            return needle.second;
+    }
+
+    return QString();
+}
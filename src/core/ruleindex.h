@@ -0,0 +1,85 @@
+#pragma once
+#ifndef RULEINDEX_H
+#define RULEINDEX_H
+
+#include "../../include/Common.h"
+#include "contenthasher.h"
+#include "patternset.h"
+
+class Database;
+
+// Blocked apps resolved for matching running processes. Executable rules
+// are keyed by the (st_dev, st_ino) of the file they point to, so symlinked
+// and canonical paths agree and a process costs one statx of /proc/N/exe.
+// Content rules ("xxh3:<size>:<digest>") hash the running binary, once per
+// distinct file, and only when its size is that of some rule. Command line
+// rules ("cmdline:<text>") search the raw, NUL-separated /proc/N/cmdline in
+// a buffer the caller reuses across processes. Paths that do not exist yet
+// are looked up by the ProcessIdentity path; flatpak, snap, "glob:" and
+// "regex:" rules are matched against it as one PatternSet. The index is
+// rebuilt when the rules change or a watched executable is replaced, e.g. by
+// a package update.
+class RuleIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RuleIndex(Database* database, QObject *parent = nullptr);
+
+    // Cheap when nothing changed; call once per scan
+    void refresh();
+    bool isEmpty() const;
+
+    // Path of the rule the process matches, or an empty string. Safe to call
+    // from several threads between refreshes, each with its own buffer.
+    QString match(pid_t pid, std::vector<char>& cmdlineBuffer) const;
+    // Forgets replaced binaries that no process matched since the last
+    // call; call after every full scan
+    void pruneRetired();
+
+private slots:
+    void onExecutableChanged(const QString& path);
+
+private:
+    using InodeKey = QPair<quint64, quint64>;
+
+    // The file a rule resolved to. Its mtime and size are kept so a retired
+    // (dev, ino), freed by an update and reused for another file, no longer
+    // matches.
+    struct InodeRule
+    {
+        QString rulePath;
+        qint64 mtimeNs;
+        quint64 size;
+    };
+
+    void rebuild();
+    void addPattern(const QString& rulePath, const QString& regex);
+    static QString globToRegex(const QString& glob);
+    QString matchCmdline(pid_t pid, std::vector<char>& buffer) const;
+
+    Database* m_database;
+    QFileSystemWatcher m_watcher;
+    qint64 m_revision;
+    bool m_dirty;
+
+    QHash<InodeKey, InodeRule> m_inodes;
+    // Old binaries replaced by an update, kept while a process still runs
+    // one; m_retiredSeen collects the ones matched during the current scan
+    QHash<InodeKey, InodeRule> m_retiredInodes;
+    mutable QMutex m_retiredMutex;
+    mutable QSet<InodeKey> m_retiredSeen;
+    QHash<quint64, QString> m_contentDigests;
+    QSet<quint64> m_contentSizes;
+    bool m_hashAnySize;
+    mutable ContentHasher m_hasher;
+    // Needle with spaces turned into NULs, and the rule path reported for it
+    QList<QPair<QByteArray, QString>> m_cmdlineNeedles;
+    // ProcessIdentity path -> rule path, for executables not installed yet
+    QHash<QString, QString> m_missingPaths;
+    // Rule path of each pattern in m_patterns, by pattern index
+    QStringList m_patternRules;
+    PatternSet m_patterns;
+};
+
+#endif // RULEINDEX_H
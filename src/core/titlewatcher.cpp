@@ -0,0 +1,144 @@
+#include "titlewatcher.h"
+#include "x11connection.h"
+#include "../data/database.h"
+
+TitleWatcher::TitleWatcher(Database* database, QObject *parent)
+    : QObject(parent),
+      m_database(database),
+      m_isWatching(false),
+      m_revision(-1),
+      m_clientListAtom(None),
+      m_netWmNameAtom(None)
+{
+    X11Connection* connection = X11Connection::instance();
+    m_clientListAtom = connection->atom("_NET_CLIENT_LIST");
+    m_netWmNameAtom = connection->atom("_NET_WM_NAME");
+}
+
+TitleWatcher::~TitleWatcher()
+{
+    stopWatching();
+}
+
+void TitleWatcher::startWatching()
+{
+    X11Connection* connection = X11Connection::instance();
+    if (m_isWatching || !connection->isValid())
+        return;
+
+    m_isWatching = true;
+    connect(connection, &X11Connection::windowPropertyChanged, this, &TitleWatcher::onWindowPropertyChanged);
+    connect(connection, &X11Connection::windowDestroyed, this, &TitleWatcher::onWindowDestroyed);
+    connection->watchProperties(connection->rootWindow());
+
+    refresh();
+}
+
+void TitleWatcher::stopWatching()
+{
+    if (!m_isWatching)
+        return;
+
+    X11Connection* connection = X11Connection::instance();
+    disconnect(connection, nullptr, this, nullptr);
+    connection->unwatchProperties(connection->rootWindow());
+    for (X11Window window : std::as_const(m_clients)) {
+        connection->unwatchProperties(window);
+    }
+
+    m_clients.clear();
+    m_matched.clear();
+    m_isWatching = false;
+}
+
+bool TitleWatcher::isWatching() const
+{
+    return m_isWatching;
+}
+
+void TitleWatcher::refresh()
+{
+    if (!m_isWatching || !m_database)
+        return;
+
+    qint64 revision = m_database->rulesRevision();
+    if (revision == m_revision)
+        return;
+
+    m_revision = revision;
+    m_matcher.build(m_database->getBlockRules("title"));
+
+    // Watch clients only while there is something to look for
+    m_matched.clear();
+    updateClientWindows(true);
+}
+
+void TitleWatcher::updateClientWindows(bool recheckAll)
+{
+    X11Connection* connection = X11Connection::instance();
+
+    QSet<X11Window> current;
+    if (!m_matcher.isEmpty()) {
+        const QList<X11Window> clients = connection->clientWindows();
+        current = QSet<X11Window>(clients.begin(), clients.end());
+    }
+
+    for (X11Window window : std::as_const(m_clients)) {
+        if (!current.contains(window)) {
+            connection->unwatchProperties(window);
+            m_matched.remove(window);
+        }
+    }
+
+    // Titles of windows already listed are followed through PropertyNotify,
+    // so a new client list costs one round trip per new window only
+    for (X11Window window : std::as_const(current)) {
+        if (!m_clients.contains(window)) {
+            connection->watchProperties(window);
+            checkWindow(window);
+        } else if (recheckAll) {
+            checkWindow(window);
+        }
+    }
+
+    m_clients = current;
+}
+
+void TitleWatcher::onWindowPropertyChanged(X11Window window, Atom property)
+{
+    X11Connection* connection = X11Connection::instance();
+
+    if (window == connection->rootWindow()) {
+        if (property == m_clientListAtom && !m_matcher.isEmpty()) {
+            updateClientWindows(false);
+        }
+        return;
+    }
+
+    if (m_clients.contains(window) && (property == m_netWmNameAtom || property == XA_WM_NAME)) {
+        checkWindow(window);
+    }
+}
+
+void TitleWatcher::onWindowDestroyed(X11Window window)
+{
+    m_clients.remove(window);
+    m_matched.remove(window);
+}
+
+void TitleWatcher::checkWindow(X11Window window)
+{
+    const QString title = X11Connection::instance()->windowTitle(window);
+    int index = m_matcher.findFirst(title);
+
+    if (index < 0) {
+        // Report again if the window later shows a blocked title
+        m_matched.remove(window);
+        return;
+    }
+
+    if (!m_matched.contains(window)) {
+        m_matched.insert(window);
+        emit titleMatched(window, title, m_matcher.keyword(index));
+    }
+}
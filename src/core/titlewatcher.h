@@ -0,0 +1,54 @@
+#pragma once
+#ifndef TITLEWATCHER_H
+#define TITLEWATCHER_H
+
+#include "../../include/Common.h"
+#include "ahocorasick.h"
+
+class Database;
+
+// Blocks windows by title keyword. Selects PropertyNotify on the root window
+// (for _NET_CLIENT_LIST) and on every managed client, and re-checks a title
+// only when its _NET_WM_NAME or WM_NAME changes. Keywords are compiled into
+// one automaton, so each title change costs a single pass over the title.
+class TitleWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TitleWatcher(Database* database, QObject *parent = nullptr);
+    ~TitleWatcher();
+
+    void startWatching();
+    void stopWatching();
+    bool isWatching() const;
+
+    // Recompiles the keywords if the rules changed, then re-checks every title
+    void refresh();
+
+signals:
+    void titleMatched(X11Window window, const QString& title, const QString& keyword);
+
+private slots:
+    void onWindowPropertyChanged(X11Window window, Atom property);
+    void onWindowDestroyed(X11Window window);
+
+private:
+    // recheckAll re-reads the titles of windows already being watched too
+    void updateClientWindows(bool recheckAll);
+    void checkWindow(X11Window window);
+
+    Database* m_database;
+    bool m_isWatching;
+    qint64 m_revision;
+
+    AhoCorasick m_matcher;
+    QSet<X11Window> m_clients;
+    // Windows already reported for their current title
+    QSet<X11Window> m_matched;
+
+    Atom m_clientListAtom;
+    Atom m_netWmNameAtom;
+};
+
+#endif // TITLEWATCHER_H
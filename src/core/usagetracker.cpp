@@ -0,0 +1,159 @@
+#include "usagetracker.h"
+#include "../data/database.h"
+#include "x11connection.h"
+#include "processidentity.h"
+
+static QString s_logFilePath;
+
+void logToFileUT(const QString& message)
+{
+    if (s_logFilePath.isEmpty()) {
+        QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir appDataDir(appDataPath);
+        if (!appDataDir.exists()) {
+            appDataDir.mkpath(".");
+        }
+        s_logFilePath = appDataDir.filePath("foccuss_service.log");
+    }
+
+    QFile logFile(s_logFilePath);
+    if (logFile.open(QIODevice::Append | QIODevice::Text)) {
+        QTextStream out(&logFile);
+        out << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
+            << " - " << message << "\n";
+        logFile.close();
+    }
+}
+
+static const int kFlushIntervalMs = 60 * 1000;
+
+UsageTracker::UsageTracker(Database* database, QObject *parent)
+    : QObject(parent),
+      m_database(database),
+      m_isTracking(false),
+      m_isIdle(false),
+      m_intervalStartMs(0)
+{
+    m_clock.start();
+    m_flushTimer.setInterval(kFlushIntervalMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &UsageTracker::flush);
+}
+
+UsageTracker::~UsageTracker()
+{
+    stopTracking();
+}
+
+void UsageTracker::startTracking()
+{
+    if (m_isTracking)
+        return;
+
+    X11Connection* connection = X11Connection::instance();
+    if (!connection->isValid() || !m_database || !m_database->isInitialized()) {
+        logToFileUT("Cannot start usage tracking - X11 or database unavailable");
+        return;
+    }
+
+    m_isTracking = true;
+    connect(connection, &X11Connection::activeWindowChanged, this, &UsageTracker::onActiveWindowChanged);
+    connect(connection, &X11Connection::userIdleChanged, this, &UsageTracker::onUserIdleChanged);
+    connection->watchActiveWindow();
+    connection->watchIdle(X11Connection::kIdleThresholdMs);
+    m_isIdle = connection->isUserIdle();
+
+    onActiveWindowChanged(connection->activeWindow());
+    m_flushTimer.start();
+}
+
+void UsageTracker::stopTracking()
+{
+    if (!m_isTracking)
+        return;
+
+    X11Connection* connection = X11Connection::instance();
+    disconnect(connection, &X11Connection::activeWindowChanged, this, &UsageTracker::onActiveWindowChanged);
+    disconnect(connection, &X11Connection::userIdleChanged, this, &UsageTracker::onUserIdleChanged);
+    connection->unwatchActiveWindow();
+
+    m_flushTimer.stop();
+    closeInterval(0);
+    flush();
+
+    m_isTracking = false;
+    m_currentApp.clear();
+}
+
+bool UsageTracker::isTracking() const
+{
+    return m_isTracking;
+}
+
+void UsageTracker::onActiveWindowChanged(X11Window window)
+{
+    closeInterval(0);
+
+    pid_t pid = X11Connection::instance()->windowPid(window);
+    m_currentApp = pid > 0 ? ProcessIdentity::resolve(pid) : QString();
+}
+
+void UsageTracker::onUserIdleChanged(bool idle)
+{
+    // Input idleness is reported kIdleThresholdMs after the last input, so
+    // entering idle ends the interval at that input rather than now; a lock
+    // right after typing reports almost no idle time. Leaving idle drops
+    // everything since, so a window left focused overnight adds nothing.
+    qint64 holdBackMs = 0;
+    if (idle) {
+        holdBackMs = X11Connection::instance()->inputIdleMs();
+        if (holdBackMs < 0) {
+            holdBackMs = X11Connection::kIdleThresholdMs;
+        }
+    }
+    closeInterval(holdBackMs);
+    m_isIdle = idle;
+}
+
+void UsageTracker::flush()
+{
+    // Split the running interval so long sessions in one app still land
+    // in the tables every flush period. The last kIdleThresholdMs stay
+    // open: if they turn out to be idle, they are never counted.
+    if (m_isTracking) {
+        closeInterval(X11Connection::kIdleThresholdMs);
+    }
+
+    if (m_pending.isEmpty())
+        return;
+
+    if (m_database->recordUsage(m_pending)) {
+        m_pending.clear();
+    } else {
+        logToFileUT("Failed to record usage, keeping it for the next flush");
+    }
+}
+
+void UsageTracker::closeInterval(qint64 holdBackMs)
+{
+    const qint64 now = m_clock.elapsed();
+    const qint64 end = qMax(m_intervalStartMs, now - holdBackMs);
+
+    if (!m_isIdle && !m_currentApp.isEmpty() && end > m_intervalStartMs) {
+        const qint64 endMs = QDateTime::currentMSecsSinceEpoch() - (now - end);
+        attribute(m_currentApp, endMs - (end - m_intervalStartMs), endMs);
+    }
+
+    m_intervalStartMs = end;
+}
+
+void UsageTracker::attribute(const QString& appPath, qint64 startMs, qint64 endMs)
+{
+    QMap<qint64, qint64>& minutes = m_pending[appPath];
+
+    while (startMs < endMs) {
+        qint64 minuteStartMs = startMs - startMs % 60000;
+        qint64 sliceEndMs = qMin(endMs, minuteStartMs + 60000);
+        minutes[minuteStartMs / 1000] += sliceEndMs - startMs;
+        startMs = sliceEndMs;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef USAGETRACKER_H
+#define USAGETRACKER_H
+
+#include "../../include/Common.h"
+
+class Database;
+
+// Accounts foreground time per app. Follows _NET_ACTIVE_WINDOW through root
+// window PropertyNotify events instead of polling, keeps per-minute totals in
+// memory and periodically adds them onto the rollup tables in one transaction.
+// Nothing is counted while the user is idle or the screen is locked.
+class UsageTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UsageTracker(Database* database, QObject *parent = nullptr);
+    ~UsageTracker();
+
+    void startTracking();
+    void stopTracking();
+    bool isTracking() const;
+
+public slots:
+    void flush();
+
+private slots:
+    void onActiveWindowChanged(X11Window window);
+    void onUserIdleChanged(bool idle);
+
+private:
+    // Counts the running interval up to now minus holdBackMs; the held back
+    // tail stays in the interval, to be counted or dropped later
+    void closeInterval(qint64 holdBackMs);
+    void attribute(const QString& appPath, qint64 startMs, qint64 endMs);
+
+    Database* m_database;
+    QTimer m_flushTimer;
+    bool m_isTracking;
+    bool m_isIdle;
+
+    // App in the foreground since m_intervalStartMs on m_clock. The
+    // monotonic clock skips suspend, so sleep is never counted as use;
+    // idle and locked time is dropped through m_isIdle.
+    QString m_currentApp;
+    QElapsedTimer m_clock;
+    qint64 m_intervalStartMs;
+
+    // appPath -> minute bucket (epoch seconds) -> milliseconds not yet flushed
+    QHash<QString, QMap<qint64, qint64>> m_pending;
+};
+
+#endif // USAGETRACKER_H
@@ -0,0 +1,620 @@
+#include "x11connection.h"
+
+static QString s_logFilePath;
+
+void logToFileXC(const QString& message)
+{
+    if (s_logFilePath.isEmpty()) {
+        QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir appDataDir(appDataPath);
+        if (!appDataDir.exists()) {
+            appDataDir.mkpath(".");
+        }
+        s_logFilePath = appDataDir.filePath("foccuss_service.log");
+    }
+
+    QFile logFile(s_logFilePath);
+    if (logFile.open(QIODevice::Append | QIODevice::Text)) {
+        QTextStream out(&logFile);
+        out << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
+            << " - " << message << "\n";
+        logFile.close();
+    }
+}
+
+// The handler is process-wide. Windows we watch can disappear at any time,
+// and the default Xlib handler would terminate the process on the resulting
+// BadWindow errors, so those are expected and dropped. Anything else is a
+// real error from some Xlib user in the process and is logged.
+static int handleX11Error(Display* display, XErrorEvent* error)
+{
+    if (error->error_code == BadWindow || error->error_code == BadDrawable || error->error_code == BadMatch)
+        return 0;
+
+    char text[256];
+    XGetErrorText(display, error->error_code, text, sizeof(text));
+    logToFileXC(QString("X11 error %1 (%2), request %3.%4, resource 0x%5")
+                    .arg(error->error_code)
+                    .arg(QString::fromLocal8Bit(text))
+                    .arg(error->request_code)
+                    .arg(error->minor_code)
+                    .arg(qulonglong(error->resourceid), 0, 16));
+    return 0;
+}
+
+X11Connection* X11Connection::instance()
+{
+    static X11Connection* s_instance = new X11Connection(QCoreApplication::instance());
+    return s_instance;
+}
+
+X11Connection::X11Connection(QObject *parent)
+    : QObject(parent),
+      m_display(nullptr),
+      m_notifier(nullptr),
+      m_hasRandr(false),
+      m_randrEventBase(0),
+      m_outputsValid(false),
+      m_layoutChangePending(false),
+      m_netActiveWindowAtom(None),
+      m_netWmPidAtom(None),
+      m_utf8StringAtom(None),
+      m_hasSync(false),
+      m_syncEventBase(0),
+      m_idleCounter(None),
+      m_idleAlarm(None),
+      m_activeAlarm(None),
+      m_idleThreshold(0),
+      m_hasScreenSaver(false),
+      m_screenSaverEventBase(0),
+      m_inputIdle(false),
+      m_screenSaverActive(false)
+{
+    m_display = XOpenDisplay(nullptr);
+    if (!m_display) {
+        logToFileXC("Failed to open X11 display");
+        return;
+    }
+
+    XSetErrorHandler(handleX11Error);
+    initializeRandr();
+    initializeIdle();
+
+    m_netActiveWindowAtom = XInternAtom(m_display, "_NET_ACTIVE_WINDOW", False);
+    m_netWmPidAtom = XInternAtom(m_display, "_NET_WM_PID", False);
+    m_utf8StringAtom = XInternAtom(m_display, "UTF8_STRING", False);
+
+    m_notifier = new QSocketNotifier(ConnectionNumber(m_display), QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &X11Connection::processEvents);
+
+    // Round trips made by other users of the connection may pull events
+    // into the Xlib queue without the socket becoming readable again.
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    if (dispatcher) {
+        connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this, &X11Connection::onAboutToBlock);
+    }
+}
+
+X11Connection::~X11Connection()
+{
+    if (m_display) {
+        if (m_idleAlarm != None)
+            XSyncDestroyAlarm(m_display, m_idleAlarm);
+        if (m_activeAlarm != None)
+            XSyncDestroyAlarm(m_display, m_activeAlarm);
+        XCloseDisplay(m_display);
+        m_display = nullptr;
+    }
+}
+
+bool X11Connection::isValid() const
+{
+    return m_display != nullptr;
+}
+
+Display* X11Connection::display() const
+{
+    return m_display;
+}
+
+X11Window X11Connection::rootWindow() const
+{
+    if (!m_display)
+        return None;
+
+    return DefaultRootWindow(m_display);
+}
+
+void X11Connection::watchWindow(X11Window window)
+{
+    if (!m_display || window == None)
+        return;
+
+    selectEvents(window, StructureNotifyMask);
+
+    // The window may already be gone, in which case no DestroyNotify will follow
+    XWindowAttributes attrs;
+    if (!XGetWindowAttributes(m_display, window, &attrs)) {
+        m_selections.remove(window);
+        QMetaObject::invokeMethod(this, [this, window]() {
+            emit windowDestroyed(window);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void X11Connection::unwatchWindow(X11Window window)
+{
+    if (!m_display || window == None)
+        return;
+
+    deselectEvents(window, StructureNotifyMask);
+}
+
+void X11Connection::watchActiveWindow()
+{
+    if (!m_display)
+        return;
+
+    selectEvents(DefaultRootWindow(m_display), PropertyChangeMask);
+}
+
+void X11Connection::unwatchActiveWindow()
+{
+    if (!m_display)
+        return;
+
+    deselectEvents(DefaultRootWindow(m_display), PropertyChangeMask);
+}
+
+X11Window X11Connection::activeWindow()
+{
+    if (!m_display)
+        return None;
+
+    Atom actualType;
+    int actualFormat;
+    unsigned long nItems, bytesAfter;
+    unsigned char* prop = nullptr;
+    X11Window window = None;
+
+    if (XGetWindowProperty(m_display, DefaultRootWindow(m_display), m_netActiveWindowAtom,
+                           0, 1, False, XA_WINDOW, &actualType, &actualFormat,
+                           &nItems, &bytesAfter, &prop) == Success) {
+        // Format 32 properties come back as an array of longs
+        if (prop && nItems > 0 && actualFormat == 32) {
+            window = static_cast<X11Window>(*reinterpret_cast<unsigned long*>(prop));
+        }
+        if (prop)
+            XFree(prop);
+    }
+
+    return window;
+}
+
+pid_t X11Connection::windowPid(X11Window window)
+{
+    if (!m_display || window == None)
+        return 0;
+
+    Atom actualType;
+    int actualFormat;
+    unsigned long nItems, bytesAfter;
+    unsigned char* prop = nullptr;
+    pid_t pid = 0;
+
+    if (XGetWindowProperty(m_display, window, m_netWmPidAtom,
+                           0, 1, False, XA_CARDINAL, &actualType, &actualFormat,
+                           &nItems, &bytesAfter, &prop) == Success) {
+        if (prop && nItems > 0 && actualFormat == 32) {
+            pid = static_cast<pid_t>(*reinterpret_cast<unsigned long*>(prop));
+        }
+        if (prop)
+            XFree(prop);
+    }
+
+    return pid;
+}
+
+void X11Connection::watchProperties(X11Window window)
+{
+    if (!m_display || window == None)
+        return;
+
+    selectEvents(window, PropertyChangeMask);
+}
+
+void X11Connection::unwatchProperties(X11Window window)
+{
+    if (!m_display || window == None)
+        return;
+
+    deselectEvents(window, PropertyChangeMask);
+}
+
+Atom X11Connection::atom(const char* name)
+{
+    if (!m_display)
+        return None;
+
+    auto it = m_atoms.constFind(QByteArray(name));
+    if (it != m_atoms.constEnd())
+        return it.value();
+
+    Atom value = XInternAtom(m_display, name, False);
+    m_atoms.insert(QByteArray(name), value);
+    return value;
+}
+
+QList<X11Window> X11Connection::clientWindows()
+{
+    QList<X11Window> windows;
+    if (!m_display)
+        return windows;
+
+    Atom actualType;
+    int actualFormat;
+    unsigned long nItems, bytesAfter;
+    unsigned char* prop = nullptr;
+
+    if (XGetWindowProperty(m_display, DefaultRootWindow(m_display), atom("_NET_CLIENT_LIST"),
+                           0, 4096, False, XA_WINDOW, &actualType, &actualFormat,
+                           &nItems, &bytesAfter, &prop) == Success) {
+        if (prop && actualFormat == 32) {
+            const unsigned long* ids = reinterpret_cast<unsigned long*>(prop);
+            for (unsigned long i = 0; i < nItems; ++i) {
+                windows.append(static_cast<X11Window>(ids[i]));
+            }
+        }
+        if (prop)
+            XFree(prop);
+    }
+
+    return windows;
+}
+
+QString X11Connection::windowTitle(X11Window window)
+{
+    if (!m_display || window == None)
+        return QString();
+
+    Atom actualType;
+    int actualFormat;
+    unsigned long nItems, bytesAfter;
+    unsigned char* prop = nullptr;
+    QString title;
+
+    if (XGetWindowProperty(m_display, window, atom("_NET_WM_NAME"),
+                           0, 1024, False, m_utf8StringAtom, &actualType, &actualFormat,
+                           &nItems, &bytesAfter, &prop) == Success) {
+        if (prop && nItems > 0 && actualFormat == 8) {
+            title = QString::fromUtf8(reinterpret_cast<char*>(prop), int(nItems));
+        }
+        if (prop)
+            XFree(prop);
+    }
+
+    if (title.isEmpty()) {
+        XTextProperty name;
+        if (XGetWMName(m_display, window, &name) && name.value) {
+            title = QString::fromUtf8(reinterpret_cast<char*>(name.value), int(name.nitems));
+            XFree(name.value);
+        }
+    }
+
+    return title;
+}
+
+void X11Connection::initializeRandr()
+{
+    int errorBase = 0;
+    if (!XRRQueryExtension(m_display, &m_randrEventBase, &errorBase)) {
+        logToFileXC("XRandR not available, treating the root window as a single output");
+        return;
+    }
+
+    m_hasRandr = true;
+    XRRSelectInput(m_display, DefaultRootWindow(m_display),
+                   RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+    XFlush(m_display);
+}
+
+void X11Connection::initializeIdle()
+{
+    int errorBase = 0;
+    int major = 0;
+    int minor = 0;
+    if (XSyncQueryExtension(m_display, &m_syncEventBase, &errorBase)
+        && XSyncInitialize(m_display, &major, &minor)) {
+        int count = 0;
+        XSyncSystemCounter *counters = XSyncListSystemCounters(m_display, &count);
+        for (int i = 0; counters && i < count; ++i) {
+            if (strcmp(counters[i].name, "IDLETIME") == 0) {
+                m_idleCounter = counters[i].counter;
+                m_hasSync = true;
+            }
+        }
+        if (counters)
+            XSyncFreeSystemCounterList(counters);
+    }
+    if (!m_hasSync) {
+        logToFileXC("XSync IDLETIME not available, input idle time is not tracked");
+    }
+
+    if (XScreenSaverQueryExtension(m_display, &m_screenSaverEventBase, &errorBase)) {
+        m_hasScreenSaver = true;
+    } else {
+        logToFileXC("MIT-SCREEN-SAVER not available, screen saver state is not tracked");
+    }
+}
+
+void X11Connection::watchIdle(int msecs)
+{
+    if (!m_display || msecs <= 0 || msecs == m_idleThreshold)
+        return;
+
+    m_idleThreshold = msecs;
+
+    if (m_hasSync) {
+        // Fires once IDLETIME passes the threshold; the reverse alarm is
+        // armed only while idle, so an active user costs no events
+        armIdleAlarm(&m_idleAlarm, XSyncPositiveComparison, msecs);
+    }
+
+    if (m_hasScreenSaver) {
+        XScreenSaverSelectInput(m_display, DefaultRootWindow(m_display), ScreenSaverNotifyMask);
+
+        XScreenSaverInfo *info = XScreenSaverAllocInfo();
+        if (info) {
+            if (XScreenSaverQueryInfo(m_display, DefaultRootWindow(m_display), info)) {
+                setIdleState(m_inputIdle, info->state == ScreenSaverOn);
+            }
+            XFree(info);
+        }
+    }
+
+    XFlush(m_display);
+}
+
+bool X11Connection::isUserIdle() const
+{
+    return m_inputIdle || m_screenSaverActive;
+}
+
+qint64 X11Connection::inputIdleMs()
+{
+    if (!m_display)
+        return -1;
+
+    XSyncValue value;
+    if (m_hasSync && XSyncQueryCounter(m_display, m_idleCounter, &value)) {
+        return (qint64(XSyncValueHigh32(value)) << 32) | XSyncValueLow32(value);
+    }
+
+    qint64 idleMs = -1;
+    if (m_hasScreenSaver) {
+        XScreenSaverInfo *info = XScreenSaverAllocInfo();
+        if (info) {
+            if (XScreenSaverQueryInfo(m_display, DefaultRootWindow(m_display), info)) {
+                idleMs = qint64(info->idle);
+            }
+            XFree(info);
+        }
+    }
+    return idleMs;
+}
+
+void X11Connection::armIdleAlarm(XSyncAlarm* alarm, XSyncTestType test, qint64 value)
+{
+    XSyncAlarmAttributes attributes;
+    attributes.trigger.counter = m_idleCounter;
+    attributes.trigger.value_type = XSyncAbsolute;
+    attributes.trigger.test_type = test;
+    XSyncIntsToValue(&attributes.trigger.wait_value, quint32(value & 0xffffffff), int(value >> 32));
+    XSyncIntToValue(&attributes.delta, 0);
+    attributes.events = True;
+
+    unsigned long flags = XSyncCACounter | XSyncCAValueType | XSyncCATestType
+                        | XSyncCAValue | XSyncCADelta | XSyncCAEvents;
+
+    // With a zero delta an alarm goes inactive once it fires; changing it re-arms it
+    if (*alarm == None) {
+        *alarm = XSyncCreateAlarm(m_display, flags, &attributes);
+    } else {
+        XSyncChangeAlarm(m_display, *alarm, flags, &attributes);
+    }
+}
+
+void X11Connection::setIdleState(bool inputIdle, bool screenSaverActive)
+{
+    bool wasIdle = isUserIdle();
+    m_inputIdle = inputIdle;
+    m_screenSaverActive = screenSaverActive;
+
+    if (isUserIdle() != wasIdle) {
+        emit userIdleChanged(isUserIdle());
+    }
+}
+
+QList<QRect> X11Connection::outputGeometries()
+{
+    if (!m_display)
+        return QList<QRect>();
+
+    if (!m_outputsValid) {
+        queryOutputs();
+    }
+
+    return m_outputs;
+}
+
+void X11Connection::queryOutputs()
+{
+    m_outputs.clear();
+    m_outputsValid = true;
+
+    X11Window root = DefaultRootWindow(m_display);
+
+    if (m_hasRandr) {
+        XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_display, root);
+        if (resources) {
+            for (int i = 0; i < resources->ncrtc; ++i) {
+                XRRCrtcInfo *crtc = XRRGetCrtcInfo(m_display, resources, resources->crtcs[i]);
+                if (!crtc)
+                    continue;
+
+                QRect geometry(crtc->x, crtc->y, int(crtc->width), int(crtc->height));
+                // Skip disabled CRTCs and collapse mirrored outputs into one
+                if (crtc->mode != None && crtc->noutput > 0 && !geometry.isEmpty()
+                    && !m_outputs.contains(geometry)) {
+                    m_outputs.append(geometry);
+                }
+
+                XRRFreeCrtcInfo(crtc);
+            }
+            XRRFreeScreenResources(resources);
+        }
+    }
+
+    if (m_outputs.isEmpty()) {
+        m_outputs.append(QRect(0, 0, DisplayWidth(m_display, DefaultScreen(m_display)),
+                               DisplayHeight(m_display, DefaultScreen(m_display))));
+    }
+}
+
+void X11Connection::emitScreenLayoutChanged()
+{
+    m_layoutChangePending = false;
+    emit screenLayoutChanged();
+}
+
+void X11Connection::selectEvents(X11Window window, long mask)
+{
+    m_selections[window][mask]++;
+    applyEventMask(window);
+}
+
+void X11Connection::deselectEvents(X11Window window, long mask)
+{
+    auto it = m_selections.find(window);
+    if (it == m_selections.end())
+        return;
+
+    auto maskIt = it->find(mask);
+    if (maskIt == it->end())
+        return;
+
+    if (--maskIt.value() <= 0) {
+        it->erase(maskIt);
+    }
+
+    applyEventMask(window);
+
+    if (it->isEmpty()) {
+        m_selections.erase(it);
+    }
+}
+
+void X11Connection::applyEventMask(X11Window window)
+{
+    long eventMask = NoEventMask;
+    auto it = m_selections.constFind(window);
+    if (it != m_selections.constEnd()) {
+        for (auto maskIt = it->constBegin(); maskIt != it->constEnd(); ++maskIt) {
+            eventMask |= maskIt.key();
+        }
+    }
+
+    XSelectInput(m_display, window, eventMask);
+    XFlush(m_display);
+}
+
+void X11Connection::onAboutToBlock()
+{
+    if (!m_display)
+        return;
+
+    XFlush(m_display);
+    if (XEventsQueued(m_display, QueuedAlready) > 0) {
+        processEvents();
+    }
+}
+
+void X11Connection::processEvents()
+{
+    if (!m_display)
+        return;
+
+    while (XPending(m_display) > 0) {
+        XEvent event;
+        XNextEvent(m_display, &event);
+        dispatchEvent(event);
+    }
+}
+
+void X11Connection::dispatchEvent(const XEvent& event)
+{
+    if (m_hasRandr && (event.type == m_randrEventBase + RRScreenChangeNotify
+                       || event.type == m_randrEventBase + RRNotify)) {
+        XEvent randrEvent = event;
+        XRRUpdateConfiguration(&randrEvent);
+
+        // A hotplug arrives as a burst of events; report it once
+        m_outputsValid = false;
+        if (!m_layoutChangePending) {
+            m_layoutChangePending = true;
+            QMetaObject::invokeMethod(this, &X11Connection::emitScreenLayoutChanged, Qt::QueuedConnection);
+        }
+        return;
+    }
+
+    if (m_hasSync && event.type == m_syncEventBase + XSyncAlarmNotify) {
+        const XSyncAlarmNotifyEvent *alarmEvent = reinterpret_cast<const XSyncAlarmNotifyEvent*>(&event);
+        qint64 idleTime = (qint64(XSyncValueHigh32(alarmEvent->counter_value)) << 32)
+                        | XSyncValueLow32(alarmEvent->counter_value);
+
+        if (alarmEvent->alarm == m_idleAlarm && !m_inputIdle) {
+            // Any input resets IDLETIME below its current value
+            armIdleAlarm(&m_activeAlarm, XSyncNegativeComparison, qMax<qint64>(idleTime - 1, 0));
+            setIdleState(true, m_screenSaverActive);
+        } else if (alarmEvent->alarm == m_activeAlarm && m_inputIdle) {
+            armIdleAlarm(&m_idleAlarm, XSyncPositiveComparison, m_idleThreshold);
+            setIdleState(false, m_screenSaverActive);
+        }
+        XFlush(m_display);
+        return;
+    }
+
+    if (m_hasScreenSaver && event.type == m_screenSaverEventBase + ScreenSaverNotify) {
+        const XScreenSaverNotifyEvent *saverEvent = reinterpret_cast<const XScreenSaverNotifyEvent*>(&event);
+        setIdleState(m_inputIdle, saverEvent->state == ScreenSaverOn);
+        return;
+    }
+
+    switch (event.type) {
+        case ConfigureNotify: {
+            const XConfigureEvent& configure = event.xconfigure;
+            emit windowConfigured(configure.window,
+                                  QRect(configure.x, configure.y, configure.width, configure.height));
+            break;
+        }
+        case MapNotify:
+            emit windowMapped(event.xmap.window);
+            break;
+        case UnmapNotify:
+            emit windowUnmapped(event.xunmap.window);
+            break;
+        case DestroyNotify:
+            m_selections.remove(event.xdestroywindow.window);
+            emit windowDestroyed(event.xdestroywindow.window);
+            break;
+        case PropertyNotify:
+            if (event.xproperty.atom == m_netActiveWindowAtom
+                && event.xproperty.window == DefaultRootWindow(m_display)) {
+                emit activeWindowChanged(activeWindow());
+            }
+            emit windowPropertyChanged(event.xproperty.window, event.xproperty.atom);
+            break;
+        default:
+            break;
+    }
+}
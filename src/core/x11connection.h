@@ -0,0 +1,113 @@
+#pragma once
+#ifndef X11CONNECTION_H
+#define X11CONNECTION_H
+
+#include "../../include/Common.h"
+
+// Process-wide Xlib connection shared by the monitor and the overlays.
+// Events are read from the connection socket through a QSocketNotifier,
+// so watchers are woken only when the X server actually sends something.
+class X11Connection : public QObject
+{
+    Q_OBJECT
+
+public:
+    static X11Connection* instance();
+    ~X11Connection();
+
+    bool isValid() const;
+    Display* display() const;
+    X11Window rootWindow() const;
+
+    // Reference counted StructureNotifyMask selection on a window
+    void watchWindow(X11Window window);
+    void unwatchWindow(X11Window window);
+
+    // Geometry of every active XRandR output, in device pixels
+    QList<QRect> outputGeometries();
+
+    // Reference counted PropertyChangeMask on the root window; while held,
+    // _NET_ACTIVE_WINDOW changes are reported through activeWindowChanged
+    void watchActiveWindow();
+    void unwatchActiveWindow();
+    X11Window activeWindow();
+    pid_t windowPid(X11Window window);
+
+    // Reference counted PropertyChangeMask on any window; changes are
+    // reported through windowPropertyChanged
+    void watchProperties(X11Window window);
+    void unwatchProperties(X11Window window);
+    // Managed top-level windows from _NET_CLIENT_LIST
+    QList<X11Window> clientWindows();
+    // _NET_WM_NAME, falling back to WM_NAME
+    QString windowTitle(X11Window window);
+    Atom atom(const char* name);
+
+    // Arms XSync IDLETIME alarms and MIT-SCREEN-SAVER notifications; the
+    // user counts as idle after msecs without input or while the screen
+    // saver (and with it most lockers) is active. There is one threshold
+    // per connection, so every consumer passes kIdleThresholdMs.
+    static const int kIdleThresholdMs = 2 * 60 * 1000;
+    void watchIdle(int msecs);
+    bool isUserIdle() const;
+    // Milliseconds since the last keyboard or mouse input, or -1 if unknown
+    qint64 inputIdleMs();
+
+signals:
+    void windowConfigured(X11Window window, const QRect& geometry);
+    void windowMapped(X11Window window);
+    void windowUnmapped(X11Window window);
+    void windowDestroyed(X11Window window);
+    void screenLayoutChanged();
+    void activeWindowChanged(X11Window window);
+    void windowPropertyChanged(X11Window window, Atom property);
+    void userIdleChanged(bool idle);
+
+private slots:
+    void processEvents();
+    void onAboutToBlock();
+    void emitScreenLayoutChanged();
+
+private:
+    explicit X11Connection(QObject *parent = nullptr);
+
+    void dispatchEvent(const XEvent& event);
+    void selectEvents(X11Window window, long mask);
+    void deselectEvents(X11Window window, long mask);
+    void applyEventMask(X11Window window);
+    void initializeRandr();
+    void initializeIdle();
+    void armIdleAlarm(XSyncAlarm* alarm, XSyncTestType test, qint64 value);
+    void setIdleState(bool inputIdle, bool screenSaverActive);
+    void queryOutputs();
+
+    Display* m_display;
+    QSocketNotifier* m_notifier;
+
+    // Per-window selection reference counts, keyed by event mask bit
+    QHash<X11Window, QHash<long, int>> m_selections;
+
+    bool m_hasRandr;
+    int m_randrEventBase;
+    bool m_outputsValid;
+    bool m_layoutChangePending;
+    QList<QRect> m_outputs;
+
+    Atom m_netActiveWindowAtom;
+    Atom m_netWmPidAtom;
+    Atom m_utf8StringAtom;
+    QHash<QByteArray, Atom> m_atoms;
+
+    bool m_hasSync;
+    int m_syncEventBase;
+    XSyncCounter m_idleCounter;
+    XSyncAlarm m_idleAlarm;
+    XSyncAlarm m_activeAlarm;
+    int m_idleThreshold;
+    bool m_hasScreenSaver;
+    int m_screenSaverEventBase;
+    bool m_inputIdle;
+    bool m_screenSaverActive;
+};
+
+#endif // X11CONNECTION_H
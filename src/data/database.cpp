@@ -109,6 +109,83 @@ bool Database::createTables()
         return false;
     }
     
+    if (!query.exec("CREATE TABLE IF NOT EXISTS app_settings ("
+                   "key TEXT PRIMARY KEY, "
+                   "value TEXT)"))
+    {
+        return false;
+    }
+
+    // Last-writer-wins stamp of each row, see BlockedAppOp
+    if (!ensureColumn("blocked_apps", "lamport", "INTEGER NOT NULL DEFAULT 0")
+        || !ensureColumn("blocked_apps", "origin", "TEXT NOT NULL DEFAULT ''"))
+    {
+        return false;
+    }
+
+    if (!query.exec("CREATE TABLE IF NOT EXISTS blocked_app_ops ("
+                   "seq INTEGER PRIMARY KEY AUTOINCREMENT, "
+                   "appPath TEXT NOT NULL, "
+                   "appName TEXT NOT NULL, "
+                   "isBlocked BOOLEAN NOT NULL, "
+                   "lamport INTEGER NOT NULL, "
+                   "origin TEXT NOT NULL, "
+                   "synced BOOLEAN NOT NULL DEFAULT 0)"))
+    {
+        return false;
+    }
+
+    if (!query.exec("CREATE TABLE IF NOT EXISTS sync_outbox ("
+                   "resource TEXT PRIMARY KEY, "
+                   "queuedAt INTEGER NOT NULL)"))
+    {
+        return false;
+    }
+
+    if (!ensureColumn("blocked_apps", "hitCount", "INTEGER NOT NULL DEFAULT 0"))
+    {
+        return false;
+    }
+
+    if (!query.exec("CREATE TABLE IF NOT EXISTS block_events ("
+                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                   "occurredAt INTEGER NOT NULL, "
+                   "appPath TEXT NOT NULL, "
+                   "appName TEXT NOT NULL, "
+                   "action TEXT NOT NULL, "
+                   "processCount INTEGER NOT NULL)"))
+    {
+        return false;
+    }
+
+    if (!query.exec("CREATE TABLE IF NOT EXISTS block_rules ("
+                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                   "kind TEXT NOT NULL, "
+                   "pattern TEXT NOT NULL, "
+                   "UNIQUE (kind, pattern))"))
+    {
+        return false;
+    }
+
+    // Every rule kind counts its hits on its own row, see appendBlockEvents
+    if (!ensureColumn("block_rules", "hitCount", "INTEGER NOT NULL DEFAULT 0")
+        || !ensureColumn("block_events", "ruleKey", "TEXT NOT NULL DEFAULT ''"))
+    {
+        return false;
+    }
+
+    // Foreground usage rollups, one row per bucket start and app
+    for (const QString& table : {QString("usage_minute"), QString("usage_hour"), QString("usage_day")}) {
+        if (!query.exec(QString("CREATE TABLE IF NOT EXISTS %1 ("
+                                "bucket INTEGER NOT NULL, "
+                                "appPath TEXT NOT NULL, "
+                                "milliseconds INTEGER NOT NULL, "
+                                "PRIMARY KEY (bucket, appPath)) WITHOUT ROWID").arg(table)))
+        {
+            return false;
+        }
+    }
+
     if (!query.exec("INSERT OR IGNORE INTO block_time_settings ("
                         "id, startHour, startMinute, endHour, endMinute, "
                         "monday, tuesday, wednesday, thursday, friday, "
@@ -124,6 +201,20 @@ bool Database::createTables()
     return true;
 }
 
+bool Database::ensureColumn(const QString& table, const QString& column, const QString& definition)
+{
+    if (m_db.record(table).contains(column))
+        return true;
+
+    QSqlQuery query(m_db);
+    if (!query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, column, definition))) {
+        _logToFile("ensureColumn failed: " + query.lastError().text());
+        return false;
+    }
+
+    return true;
+}
+
 #pragma region BlockedApp
 
 bool Database::addBlockedApp(const QString& appPath, const QString& appName)
@@ -132,33 +223,78 @@ bool Database::addBlockedApp(const QString& appPath, const QString& appName)
     
     QString normalizedPath = QDir::cleanPath(appPath).replace("\\", "/");
 
+    if (!beginWriteTransaction()) return false;
+
+    qint64 lamport = tickLamport(0);
+
+    // An upsert rather than REPLACE, which would delete the row and lose hitCount
     QSqlQuery query(m_db);
-    query.prepare("INSERT OR REPLACE INTO blocked_apps (appPath, appName, isBlocked) VALUES (:normalizedPath, :appPath, 1)");
+    query.prepare("INSERT INTO blocked_apps (appPath, appName, isBlocked, lamport, origin) "
+                  "VALUES (:normalizedPath, :appPath, 1, :lamport, :origin) "
+                  "ON CONFLICT(appPath) DO UPDATE SET appName = excluded.appName, isBlocked = 1, "
+                  "lamport = excluded.lamport, origin = excluded.origin");
     query.bindValue(":normalizedPath", normalizedPath);
     query.bindValue(":appPath", appName);
+    query.bindValue(":lamport", lamport);
+    query.bindValue(":origin", clientId());
     
-    if (!query.exec()) {
+    if (!query.exec() || !recordLocalOp(normalizedPath, appName, true) || !bumpRulesRevision()) {
         qDebug() << "Error adding blocked app:" << query.lastError().text();
+        m_db.rollback();
         return false;
     }
     
-    return true;
+    return m_db.commit();
 }
 
 bool Database::removeBlockedApp(const QString& appPath)
 {
     if (!m_initialized) return false;
     
+    if (!beginWriteTransaction()) return false;
+
+    QSqlQuery select(m_db);
+    select.prepare("SELECT appPath, appName FROM blocked_apps WHERE appPath LIKE :path");
+    select.bindValue(":path", appPath);
+    if (!select.exec()) {
+        qDebug() << "Error removing blocked app:" << select.lastError().text();
+        m_db.rollback();
+        return false;
+    }
+
+    QList<QPair<QString, QString>> rows;
+    while (select.next()) {
+        rows.append(qMakePair(select.value(0).toString(), select.value(1).toString()));
+    }
+
+    qint64 lamport = tickLamport(0);
+
     QSqlQuery query(m_db);
-    query.prepare("UPDATE blocked_apps SET isBlocked = 0 WHERE appPath LIKE :path");
+    query.prepare("UPDATE blocked_apps SET isBlocked = 0, lamport = :lamport, origin = :origin "
+                  "WHERE appPath LIKE :path");
+    query.bindValue(":lamport", lamport);
+    query.bindValue(":origin", clientId());
     query.bindValue(":path", appPath);
     
     if (!query.exec()) {
         qDebug() << "Error removing blocked app:" << query.lastError().text();
+        m_db.rollback();
+        return false;
+    }
+
+    for (const auto& row : rows) {
+        if (!recordLocalOp(row.first, row.second, false)) {
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    if (!bumpRulesRevision()) {
+        m_db.rollback();
         return false;
     }
     
-    return true;
+    return m_db.commit();
 }
 
 bool Database::isAppBlocked(const QString& appPath) const
@@ -199,6 +335,667 @@ QList<std::shared_ptr<AppModel>> Database::getBlockedApps() const
 
 #pragma endregion BlockedApp
 
+#pragma region Replication
+
+QString Database::clientId()
+{
+    QString id = getSetting("sync/clientId").toString();
+    if (id.isEmpty()) {
+        id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        setSetting("sync/clientId", id);
+    }
+
+    return id;
+}
+
+// BEGIN IMMEDIATE takes the write lock up front. With a deferred BEGIN the
+// service and the window could both read the same clock value and stamp
+// two writes alike; here the second one waits for the first to commit.
+bool Database::beginWriteTransaction()
+{
+    QSqlQuery query(m_db);
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        _logToFile("beginWriteTransaction failed: " + query.lastError().text());
+        return false;
+    }
+
+    return true;
+}
+
+// Advances the Lamport clock past both the local time and anything observed
+// from a peer, and returns the new value. Callers hold a write transaction.
+qint64 Database::tickLamport(qint64 observed)
+{
+    qint64 clock = qMax(getSetting("sync/lamport", 0).toLongLong(), observed) + 1;
+    setSetting("sync/lamport", clock);
+    return clock;
+}
+
+// Bumped by every write to blocked_apps or block_rules, in the same
+// transaction, so readers in any process see rule changes and nothing else
+bool Database::bumpRulesRevision()
+{
+    return setSetting("rules/revision", rulesRevision() + 1);
+}
+
+bool Database::recordLocalOp(const QString& appPath, const QString& appName, bool blocked)
+{
+    QSqlQuery query(m_db);
+    query.prepare("INSERT INTO blocked_app_ops (appPath, appName, isBlocked, lamport, origin) "
+                  "SELECT appPath, appName, :isBlocked, lamport, origin FROM blocked_apps WHERE appPath = :path");
+    query.bindValue(":isBlocked", blocked);
+    query.bindValue(":path", appPath);
+
+    if (!query.exec()) {
+        _logToFile("recordLocalOp failed for " + appName + ": " + query.lastError().text());
+        return false;
+    }
+
+    return true;
+}
+
+bool Database::applyBlockedAppOps(const QList<BlockedAppOp>& ops)
+{
+    if (!m_initialized) return false;
+    if (ops.isEmpty()) return true;
+
+    QVariantList paths, names, blocked, lamports, origins;
+    qint64 observed = 0;
+    for (const BlockedAppOp& op : ops) {
+        if (op.appPath.isEmpty())
+            continue;
+        paths << op.appPath;
+        names << op.appName;
+        blocked << op.blocked;
+        lamports << op.lamport;
+        origins << op.origin;
+        observed = qMax(observed, op.lamport);
+    }
+
+    if (!beginWriteTransaction()) return false;
+
+    // Last writer wins; the origin breaks ties between concurrent writes
+    QSqlQuery query(m_db);
+    query.prepare("INSERT INTO blocked_apps (appPath, appName, isBlocked, lamport, origin) "
+                  "VALUES (?, ?, ?, ?, ?) "
+                  "ON CONFLICT(appPath) DO UPDATE SET "
+                  "appName = excluded.appName, isBlocked = excluded.isBlocked, "
+                  "lamport = excluded.lamport, origin = excluded.origin "
+                  "WHERE excluded.lamport > blocked_apps.lamport "
+                  "OR (excluded.lamport = blocked_apps.lamport AND excluded.origin > blocked_apps.origin)");
+    query.addBindValue(paths);
+    query.addBindValue(names);
+    query.addBindValue(blocked);
+    query.addBindValue(lamports);
+    query.addBindValue(origins);
+
+    if (!query.execBatch() || !bumpRulesRevision()) {
+        _logToFile("applyBlockedAppOps failed: " + query.lastError().text());
+        m_db.rollback();
+        return false;
+    }
+
+    // Remote ops only move the clock; they are never appended to the log
+    tickLamport(observed);
+
+    return m_db.commit();
+}
+
+QHash<QString, BlockedAppOp> Database::getBlockedAppStates() const
+{
+    QHash<QString, BlockedAppOp> result;
+
+    if (!m_initialized) return result;
+
+    QSqlQuery query(m_db);
+    if (!query.exec("SELECT appPath, appName, isBlocked, lamport, origin FROM blocked_apps")) {
+        _logToFile("getBlockedAppStates failed: " + query.lastError().text());
+        return result;
+    }
+
+    while (query.next()) {
+        BlockedAppOp state = { 0, query.value(0).toString(), query.value(1).toString(),
+                               query.value(2).toBool(), query.value(3).toLongLong(), query.value(4).toString() };
+        result.insert(state.appPath, state);
+    }
+
+    return result;
+}
+
+bool Database::applyBlockedAppChanges(const QList<BlockedAppOp>& changes)
+{
+    if (!m_initialized) return false;
+    if (changes.isEmpty()) return true;
+
+    if (!beginWriteTransaction()) return false;
+
+    if (!writeBlockedAppChanges(changes)) {
+        m_db.rollback();
+        return false;
+    }
+
+    return m_db.commit();
+}
+
+bool Database::applyState(const QList<BlockedAppOp>& changes,
+                          const std::shared_ptr<BlockTimeSettingsModel>& settings)
+{
+    if (!m_initialized) return false;
+
+    if (!beginWriteTransaction()) return false;
+
+    if (!writeBlockedAppChanges(changes) || (settings && !updateBlockTimeSettings(settings))) {
+        m_db.rollback();
+        return false;
+    }
+
+    return m_db.commit();
+}
+
+// A path with an op still waiting for upload keeps its local state: the
+// document was produced before the server saw that op
+static const char* const kNoPendingOp =
+    "NOT EXISTS (SELECT 1 FROM blocked_app_ops AS pending "
+    "WHERE pending.appPath = excluded.appPath AND pending.synced = 0)";
+
+bool Database::writeBlockedAppChanges(const QList<BlockedAppOp>& changes)
+{
+    if (changes.isEmpty()) return true;
+
+    // Rows the server stamped merge like pulled ops; rows without a clock
+    // only replace the content and keep whatever clock the row already had
+    QVariantList paths, names, blocked, lamports, origins;
+    QVariantList plainPaths, plainNames, plainBlocked;
+    qint64 observed = 0;
+    for (const BlockedAppOp& change : changes) {
+        if (change.lamport > 0) {
+            paths << change.appPath;
+            names << change.appName;
+            blocked << change.blocked;
+            lamports << change.lamport;
+            origins << change.origin;
+            observed = qMax(observed, change.lamport);
+        } else {
+            plainPaths << change.appPath;
+            plainNames << change.appName;
+            plainBlocked << change.blocked;
+        }
+    }
+
+    if (!paths.isEmpty()) {
+        QSqlQuery query(m_db);
+        query.prepare(QString("INSERT INTO blocked_apps (appPath, appName, isBlocked, lamport, origin) "
+                              "VALUES (?, ?, ?, ?, ?) "
+                              "ON CONFLICT(appPath) DO UPDATE SET "
+                              "appName = excluded.appName, isBlocked = excluded.isBlocked, "
+                              "lamport = excluded.lamport, origin = excluded.origin "
+                              "WHERE %1 AND (excluded.lamport > blocked_apps.lamport "
+                              "OR (excluded.lamport = blocked_apps.lamport "
+                              "AND excluded.origin > blocked_apps.origin))").arg(kNoPendingOp));
+        query.addBindValue(paths);
+        query.addBindValue(names);
+        query.addBindValue(blocked);
+        query.addBindValue(lamports);
+        query.addBindValue(origins);
+
+        if (!query.execBatch()) {
+            _logToFile("writeBlockedAppChanges failed: " + query.lastError().text());
+            return false;
+        }
+
+        tickLamport(observed);
+    }
+
+    if (!plainPaths.isEmpty()) {
+        // New rows get clock 0, so any op for the app wins over them
+        QSqlQuery query(m_db);
+        query.prepare(QString("INSERT INTO blocked_apps (appPath, appName, isBlocked, lamport, origin) "
+                              "VALUES (?, ?, ?, 0, '') "
+                              "ON CONFLICT(appPath) DO UPDATE SET "
+                              "appName = excluded.appName, isBlocked = excluded.isBlocked "
+                              "WHERE %1").arg(kNoPendingOp));
+        query.addBindValue(plainPaths);
+        query.addBindValue(plainNames);
+        query.addBindValue(plainBlocked);
+
+        if (!query.execBatch()) {
+            _logToFile("writeBlockedAppChanges failed: " + query.lastError().text());
+            return false;
+        }
+    }
+
+    return bumpRulesRevision();
+}
+
+QList<BlockedAppOp> Database::getPendingBlockedAppOps(int limit) const
+{
+    QList<BlockedAppOp> result;
+
+    if (!m_initialized) return result;
+
+    QSqlQuery query(m_db);
+    query.prepare("SELECT seq, appPath, appName, isBlocked, lamport, origin FROM blocked_app_ops "
+                  "WHERE synced = 0 ORDER BY seq LIMIT :limit");
+    query.bindValue(":limit", limit);
+
+    if (!query.exec()) {
+        _logToFile("getPendingBlockedAppOps failed: " + query.lastError().text());
+        return result;
+    }
+
+    while (query.next()) {
+        result.append({ query.value(0).toLongLong(), query.value(1).toString(), query.value(2).toString(),
+                        query.value(3).toBool(), query.value(4).toLongLong(), query.value(5).toString() });
+    }
+
+    return result;
+}
+
+bool Database::markBlockedAppOpsSynced(qint64 upToSeq)
+{
+    if (!m_initialized) return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE blocked_app_ops SET synced = 1 WHERE synced = 0 AND seq <= :seq");
+    query.bindValue(":seq", upToSeq);
+
+    if (!query.exec()) {
+        _logToFile("markBlockedAppOpsSynced failed: " + query.lastError().text());
+        return false;
+    }
+
+    return true;
+}
+
+bool Database::compactBlockedAppOps()
+{
+    if (!m_initialized) return false;
+
+    QSqlQuery query(m_db);
+
+    // Acknowledged ops are already reflected in blocked_apps, and a pending
+    // op is redundant once a later one for the same app is queued
+    if (!query.exec("DELETE FROM blocked_app_ops WHERE synced = 1")
+        || !query.exec("DELETE FROM blocked_app_ops WHERE synced = 0 AND seq < "
+                       "(SELECT MAX(seq) FROM blocked_app_ops AS later "
+                       "WHERE later.appPath = blocked_app_ops.appPath AND later.synced = 0)")) {
+        _logToFile("compactBlockedAppOps failed: " + query.lastError().text());
+        return false;
+    }
+
+    return true;
+}
+
+qint64 Database::rulesRevision() const
+{
+    return getSetting("rules/revision", 0).toLongLong();
+}
+
+#pragma endregion Replication
+
+#pragma region SyncOutbox
+
+bool Database::queueSync(const QString& resource)
+{
+    if (!m_initialized) return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO sync_outbox (resource, queuedAt) VALUES (:resource, :queuedAt)");
+    query.bindValue(":resource", resource);
+    query.bindValue(":queuedAt", QDateTime::currentMSecsSinceEpoch());
+
+    if (!query.exec()) {
+        _logToFile("queueSync failed: " + query.lastError().text());
+        return false;
+    }
+
+    return true;
+}
+
+bool Database::clearQueuedSync(const QString& resource, qint64 queuedAt)
+{
+    if (!m_initialized) return false;
+
+    // A newer edit re-queued the resource while the upload was in flight
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM sync_outbox WHERE resource = :resource AND queuedAt <= :queuedAt");
+    query.bindValue(":resource", resource);
+    query.bindValue(":queuedAt", queuedAt);
+
+    if (!query.exec()) {
+        _logToFile("clearQueuedSync failed: " + query.lastError().text());
+        return false;
+    }
+
+    return query.numRowsAffected() > 0;
+}
+
+QList<QPair<QString, qint64>> Database::getQueuedSyncs() const
+{
+    QList<QPair<QString, qint64>> result;
+
+    if (!m_initialized) return result;
+
+    QSqlQuery query(m_db);
+    if (!query.exec("SELECT resource, queuedAt FROM sync_outbox ORDER BY queuedAt")) {
+        _logToFile("getQueuedSyncs failed: " + query.lastError().text());
+        return result;
+    }
+
+    while (query.next()) {
+        result.append(qMakePair(query.value(0).toString(), query.value(1).toLongLong()));
+    }
+
+    return result;
+}
+
+#pragma endregion SyncOutbox
+
+#pragma region BlockRules
+
+bool Database::addBlockRule(const QString& kind, const QString& pattern)
+{
+    if (!m_initialized) return false;
+
+    if (!beginWriteTransaction()) return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR IGNORE INTO block_rules (kind, pattern) VALUES (:kind, :pattern)");
+    query.bindValue(":kind", kind);
+    query.bindValue(":pattern", pattern);
+
+    if (!query.exec() || !bumpRulesRevision()) {
+        _logToFile("addBlockRule failed: " + query.lastError().text());
+        m_db.rollback();
+        return false;
+    }
+
+    return m_db.commit();
+}
+
+bool Database::removeBlockRule(const QString& kind, const QString& pattern)
+{
+    if (!m_initialized) return false;
+
+    if (!beginWriteTransaction()) return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM block_rules WHERE kind = :kind AND pattern = :pattern");
+    query.bindValue(":kind", kind);
+    query.bindValue(":pattern", pattern);
+
+    if (!query.exec() || !bumpRulesRevision()) {
+        _logToFile("removeBlockRule failed: " + query.lastError().text());
+        m_db.rollback();
+        return false;
+    }
+
+    return m_db.commit();
+}
+
+QStringList Database::getBlockRules(const QString& kind) const
+{
+    QStringList patterns;
+    if (!m_initialized) return patterns;
+
+    QSqlQuery query(m_db);
+    query.prepare("SELECT pattern FROM block_rules WHERE kind = :kind ORDER BY id");
+    query.bindValue(":kind", kind);
+
+    if (!query.exec()) {
+        _logToFile("getBlockRules failed: " + query.lastError().text());
+        return patterns;
+    }
+
+    while (query.next()) {
+        patterns.append(query.value(0).toString());
+    }
+
+    return patterns;
+}
+
+#pragma endregion BlockRules
+
+#pragma region BlockEvents
+
+// Kinds of block_rules rows; their rule keys are "<kind>:<pattern>"
+static const QStringList kPatternRuleKinds = {"title", "cmdline", "glob", "regex"};
+
+bool Database::appendBlockEvents(const QList<BlockEvent>& events, const QHash<QString, qint64>& hits)
+{
+    if (!m_initialized) return false;
+    if (events.isEmpty() && hits.isEmpty()) return true;
+
+    QVariantList occurredAt, ruleKeys, paths, names, actions, processCounts;
+    for (const BlockEvent& event : events) {
+        occurredAt << event.occurredAt;
+        ruleKeys << event.ruleKey;
+        paths << event.appPath;
+        names << event.appName;
+        actions << event.action;
+        processCounts << event.processCount;
+    }
+
+    QVariantList appPaths, appHits, ruleKinds, rulePatterns, ruleHits;
+    for (auto it = hits.constBegin(); it != hits.constEnd(); ++it) {
+        const int colon = it.key().indexOf(':');
+        const QString kind = colon > 0 ? it.key().left(colon) : QString();
+        if (kPatternRuleKinds.contains(kind)) {
+            ruleKinds << kind;
+            rulePatterns << it.key().mid(colon + 1);
+            ruleHits << it.value();
+        } else {
+            appPaths << it.key();
+            appHits << it.value();
+        }
+    }
+
+    m_db.transaction();
+
+    QSqlQuery insert(m_db);
+    insert.prepare("INSERT INTO block_events (occurredAt, ruleKey, appPath, appName, action, processCount) "
+                   "VALUES (?, ?, ?, ?, ?, ?)");
+    insert.addBindValue(occurredAt);
+    insert.addBindValue(ruleKeys);
+    insert.addBindValue(paths);
+    insert.addBindValue(names);
+    insert.addBindValue(actions);
+    insert.addBindValue(processCounts);
+
+    if (!events.isEmpty() && !insert.execBatch()) {
+        _logToFile("appendBlockEvents failed: " + insert.lastError().text());
+        m_db.rollback();
+        return false;
+    }
+
+    QSqlQuery update(m_db);
+    update.prepare("UPDATE blocked_apps SET hitCount = hitCount + ? WHERE appPath = ?");
+    update.addBindValue(appHits);
+    update.addBindValue(appPaths);
+
+    if (!appPaths.isEmpty() && !update.execBatch()) {
+        _logToFile("appendBlockEvents hit count update failed: " + update.lastError().text());
+        m_db.rollback();
+        return false;
+    }
+
+    QSqlQuery ruleUpdate(m_db);
+    ruleUpdate.prepare("UPDATE block_rules SET hitCount = hitCount + ? WHERE kind = ? AND pattern = ?");
+    ruleUpdate.addBindValue(ruleHits);
+    ruleUpdate.addBindValue(ruleKinds);
+    ruleUpdate.addBindValue(rulePatterns);
+
+    if (!ruleKinds.isEmpty() && !ruleUpdate.execBatch()) {
+        _logToFile("appendBlockEvents hit count update failed: " + ruleUpdate.lastError().text());
+        m_db.rollback();
+        return false;
+    }
+
+    return m_db.commit();
+}
+
+QList<BlockEvent> Database::getBlockEvents(qint64 beforeId, int limit) const
+{
+    QList<BlockEvent> events;
+    if (!m_initialized) return events;
+
+    // Seek on the primary key instead of OFFSET, so deep pages cost the same as the first
+    QSqlQuery query(m_db);
+    query.prepare("SELECT id, occurredAt, ruleKey, appPath, appName, action, processCount FROM block_events "
+                  "WHERE id < :beforeId ORDER BY id DESC LIMIT :limit");
+    query.bindValue(":beforeId", beforeId > 0 ? beforeId : std::numeric_limits<qint64>::max());
+    query.bindValue(":limit", limit);
+
+    if (!query.exec()) {
+        _logToFile("getBlockEvents failed: " + query.lastError().text());
+        return events;
+    }
+
+    while (query.next()) {
+        BlockEvent event;
+        event.id = query.value(0).toLongLong();
+        event.occurredAt = query.value(1).toLongLong();
+        event.ruleKey = query.value(2).toString();
+        event.appPath = query.value(3).toString();
+        event.appName = query.value(4).toString();
+        event.action = query.value(5).toString();
+        event.processCount = query.value(6).toInt();
+        events.append(event);
+    }
+
+    return events;
+}
+
+QHash<QString, qint64> Database::getBlockHitCounts() const
+{
+    QHash<QString, qint64> counts;
+    if (!m_initialized) return counts;
+
+    QSqlQuery query(m_db);
+    if (!query.exec("SELECT appPath, hitCount FROM blocked_apps WHERE hitCount > 0 "
+                    "UNION ALL "
+                    "SELECT kind || ':' || pattern, hitCount FROM block_rules WHERE hitCount > 0")) {
+        _logToFile("getBlockHitCounts failed: " + query.lastError().text());
+        return counts;
+    }
+
+    while (query.next()) {
+        counts.insert(query.value(0).toString(), query.value(1).toLongLong());
+    }
+
+    return counts;
+}
+
+#pragma endregion BlockEvents
+
+#pragma region Usage
+
+// Minute rows only serve the recent past; older ones are covered by the hour rollup
+static const qint64 kUsageMinuteRetentionSecs = 2 * 24 * 60 * 60;
+static const qint64 kUsageHourRetentionSecs = 90 * 24 * 60 * 60;
+
+bool Database::recordUsage(const QHash<QString, QMap<qint64, qint64>>& minutes)
+{
+    if (!m_initialized) return false;
+    if (minutes.isEmpty()) return true;
+
+    QHash<QString, QMap<qint64, qint64>> hours;
+    QHash<QString, QMap<qint64, qint64>> days;
+    for (auto appIt = minutes.constBegin(); appIt != minutes.constEnd(); ++appIt) {
+        for (auto it = appIt->constBegin(); it != appIt->constEnd(); ++it) {
+            // Days follow the local calendar, so a day is not always 24 hours
+            qint64 day = QDateTime::fromSecsSinceEpoch(it.key()).date().startOfDay().toSecsSinceEpoch();
+            hours[appIt.key()][it.key() - it.key() % 3600] += it.value();
+            days[appIt.key()][day] += it.value();
+        }
+    }
+
+    m_db.transaction();
+
+    if (!addUsage("usage_minute", minutes) || !addUsage("usage_hour", hours) || !addUsage("usage_day", days)) {
+        m_db.rollback();
+        return false;
+    }
+
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    QSqlQuery prune(m_db);
+    prune.prepare("DELETE FROM usage_minute WHERE bucket < :cutoff");
+    prune.bindValue(":cutoff", now - kUsageMinuteRetentionSecs);
+    if (!prune.exec()) {
+        _logToFile("recordUsage prune failed: " + prune.lastError().text());
+    }
+    prune.prepare("DELETE FROM usage_hour WHERE bucket < :cutoff");
+    prune.bindValue(":cutoff", now - kUsageHourRetentionSecs);
+    if (!prune.exec()) {
+        _logToFile("recordUsage prune failed: " + prune.lastError().text());
+    }
+
+    return m_db.commit();
+}
+
+bool Database::addUsage(const QString& table, const QHash<QString, QMap<qint64, qint64>>& buckets)
+{
+    QVariantList bucketStarts, paths, durations;
+    for (auto appIt = buckets.constBegin(); appIt != buckets.constEnd(); ++appIt) {
+        for (auto it = appIt->constBegin(); it != appIt->constEnd(); ++it) {
+            bucketStarts << it.key();
+            paths << appIt.key();
+            durations << it.value();
+        }
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare(QString("INSERT INTO %1 (bucket, appPath, milliseconds) VALUES (?, ?, ?) "
+                          "ON CONFLICT (bucket, appPath) DO UPDATE "
+                          "SET milliseconds = milliseconds + excluded.milliseconds").arg(table));
+    query.addBindValue(bucketStarts);
+    query.addBindValue(paths);
+    query.addBindValue(durations);
+
+    if (!query.execBatch()) {
+        _logToFile("addUsage failed for " + table + ": " + query.lastError().text());
+        return false;
+    }
+
+    return true;
+}
+
+QList<QPair<QString, qint64>> Database::getUsageTotals(UsageResolution resolution, qint64 from, qint64 to) const
+{
+    QList<QPair<QString, qint64>> totals;
+    if (!m_initialized) return totals;
+
+    QSqlQuery query(m_db);
+    query.prepare(QString("SELECT appPath, SUM(milliseconds) AS total FROM %1 "
+                          "WHERE bucket >= :from AND bucket < :to "
+                          "GROUP BY appPath ORDER BY total DESC").arg(usageTable(resolution)));
+    query.bindValue(":from", from);
+    query.bindValue(":to", to);
+
+    if (!query.exec()) {
+        _logToFile("getUsageTotals failed: " + query.lastError().text());
+        return totals;
+    }
+
+    while (query.next()) {
+        totals.append(qMakePair(query.value(0).toString(), query.value(1).toLongLong()));
+    }
+
+    return totals;
+}
+
+QString Database::usageTable(UsageResolution resolution)
+{
+    switch (resolution) {
+        case UsageResolution::Minute: return "usage_minute";
+        case UsageResolution::Hour: return "usage_hour";
+        case UsageResolution::Day: return "usage_day";
+    }
+    return "usage_day";
+}
+
+#pragma endregion Usage
+
 #pragma region BlockTimeSettings
 
 std::shared_ptr<BlockTimeSettingsModel> Database::getBlockTimeSettings() const
@@ -341,4 +1138,44 @@ bool Database::isBlockingNow() const
     }
 }
 
-#pragma endregion BlockTimeSettings
\ No newline at end of file
+#pragma endregion BlockTimeSettings
+
+#pragma region Settings
+
+QVariant Database::getSetting(const QString& key, const QVariant& defaultValue) const
+{
+    if (!m_initialized) return defaultValue;
+
+    QSqlQuery query(m_db);
+    query.prepare("SELECT value FROM app_settings WHERE key = :key");
+    query.bindValue(":key", key);
+
+    if (!query.exec()) {
+        _logToFile("getSetting failed: " + query.lastError().text());
+        return defaultValue;
+    }
+
+    if (query.next())
+        return query.value(0);
+
+    return defaultValue;
+}
+
+bool Database::setSetting(const QString& key, const QVariant& value)
+{
+    if (!m_initialized) return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO app_settings (key, value) VALUES (:key, :value)");
+    query.bindValue(":key", key);
+    query.bindValue(":value", value.toString());
+
+    if (!query.exec()) {
+        _logToFile("setSetting failed: " + query.lastError().text());
+        return false;
+    }
+
+    return true;
+}
+
+#pragma endregion Settings
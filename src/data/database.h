@@ -8,6 +8,40 @@ class AppModel;
 class BlockTimeSettingsModel;
 struct REG_Week;
 
+// One add/remove of a blocked app in the replication log. Ops are ordered
+// by (lamport, origin), so every replica settles on the same winner.
+struct BlockedAppOp
+{
+    qint64 seq;
+    QString appPath;
+    QString appName;
+    bool blocked;
+    qint64 lamport;
+    QString origin;
+};
+
+// One enforcement of a block; rows are append-only and ids grow with time
+struct BlockEvent
+{
+    qint64 id;
+    qint64 occurredAt;
+    // Rule that matched: a blocked_apps path, or "<kind>:<pattern>" for a
+    // block_rules row; empty for events recorded before it was kept
+    QString ruleKey;
+    QString appPath;
+    QString appName;
+    QString action;
+    int processCount;
+};
+
+// Granularity of the foreground usage rollups
+enum class UsageResolution
+{
+    Minute,
+    Hour,
+    Day
+};
+
 class Database
 {
 public:
@@ -22,13 +56,63 @@ public:
     bool isAppBlocked(const QString& appPath) const;
     QList<std::shared_ptr<AppModel>> getBlockedApps() const;
 
+    // Replication of blocked apps; local edits above append to the log
+    QString clientId();
+    bool applyBlockedAppOps(const QList<BlockedAppOp>& ops);
+    // Current rows keyed by path, for diffing a fetched document off-thread
+    QHash<QString, BlockedAppOp> getBlockedAppStates() const;
+    bool applyBlockedAppChanges(const QList<BlockedAppOp>& changes);
+    // Blocked-app changes and schedule of one state snapshot, all or nothing
+    bool applyState(const QList<BlockedAppOp>& changes, const std::shared_ptr<BlockTimeSettingsModel>& settings);
+    // Changes whenever blocked apps or block rules change, in this process or another
+    qint64 rulesRevision() const;
+    QList<BlockedAppOp> getPendingBlockedAppOps(int limit) const;
+    bool markBlockedAppOpsSynced(qint64 upToSeq);
+    bool compactBlockedAppOps();
+
+    // Outbox of resources with local changes still to be uploaded. One row
+    // per resource, so repeated edits collapse into a single upload.
+    bool queueSync(const QString& resource);
+    bool clearQueuedSync(const QString& resource, qint64 queuedAt);
+    QList<QPair<QString, qint64>> getQueuedSyncs() const;
+
+    // Foreground time per app, keyed by minute bucket (epoch seconds) in
+    // milliseconds; added onto the minute, hour and day rollups at once
+    bool recordUsage(const QHash<QString, QMap<qint64, qint64>>& minutes);
+    // Milliseconds per app in [from, to), largest first
+    QList<QPair<QString, qint64>> getUsageTotals(UsageResolution resolution, qint64 from, qint64 to) const;
+
+    // Rules other than blocked executables, e.g. kind "title" with a keyword
+    bool addBlockRule(const QString& kind, const QString& pattern);
+    bool removeBlockRule(const QString& kind, const QString& pattern);
+    QStringList getBlockRules(const QString& kind) const;
+
+    // Appends events and adds hits, keyed by rule key, onto the hitCount of
+    // the blocked_apps or block_rules row of each rule in one transaction
+    bool appendBlockEvents(const QList<BlockEvent>& events, const QHash<QString, qint64>& hits);
+    // Newest first, strictly older than beforeId (0 for the newest page)
+    QList<BlockEvent> getBlockEvents(qint64 beforeId, int limit) const;
+    // Rule key -> hits
+    QHash<QString, qint64> getBlockHitCounts() const;
+
     std::shared_ptr<BlockTimeSettingsModel> getBlockTimeSettings() const;
     bool updateBlockTimeSettings(const std::shared_ptr<BlockTimeSettingsModel>& settings);
     bool isBlockingActive() const;
     bool isBlockingNow() const;
 
+    QVariant getSetting(const QString& key, const QVariant& defaultValue = QVariant()) const;
+    bool setSetting(const QString& key, const QVariant& value);
+
 private:
     bool createTables();
+    bool ensureColumn(const QString& table, const QString& column, const QString& definition);
+    bool beginWriteTransaction();
+    qint64 tickLamport(qint64 observed);
+    bool bumpRulesRevision();
+    bool writeBlockedAppChanges(const QList<BlockedAppOp>& changes);
+    bool recordLocalOp(const QString& appPath, const QString& appName, bool blocked);
+    bool addUsage(const QString& table, const QHash<QString, QMap<qint64, qint64>>& buckets);
+    static QString usageTable(UsageResolution resolution);
     
     QSqlDatabase m_db;
     bool m_initialized;
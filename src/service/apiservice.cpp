@@ -30,20 +30,265 @@ void logToFileAS(const QString& message) {
     }
 }
 
+static const char* const kBlockedAppsResource = "/blocked-apps/linux";
+static const char* const kTimeSettingsResource = "/block-time-settings/linux";
+static const char* const kBlockedAppOpsResource = "/blocked-apps/linux/ops";
+static const char* const kStateResource = "/state/linux";
+static const int kMaxOpsPerPush = 500;
+static const char* const kAcceptHeader = "application/cbor, application/json;q=0.9";
+// Bodies smaller than this are not worth the deflate header and CPU
+static const int kCompressThreshold = 1024;
+// Quiet period that folds a burst of edits into one upload
+static const int kOutboxDebounceMsecs = 2000;
+static const int kOutboxMinBackoffMsecs = 5000;
+static const int kOutboxMaxBackoffMsecs = 5 * 60 * 1000;
+static const char* const kDefaultBaseUrl = "http://ec2-18-219-89-146.us-east-2.compute.amazonaws.com:3000";
+static const char* const kPushResource = "/events/linux";
+// The server sends a heartbeat at least every 15 s; three missed ones mean a dead link
+static const int kPushHeartbeatTimeoutMsecs = 45000;
+static const int kPushMinBackoffMsecs = 1000;
+static const int kPushMaxBackoffMsecs = 60000;
+// Request layer: deadline per attempt, parallel requests, GET retries
+static const int kRequestTimeoutMsecs = 15000;
+static const int kMaxConcurrentRequests = 4;
+static const int kMaxRequestAttempts = 3;
+static const int kRetryBaseMsecs = 500;
+// Consecutive transient failures that open the circuit, and its cooldown range
+static const int kCircuitFailureThreshold = 5;
+static const int kCircuitMinCooldownMsecs = 10000;
+static const int kCircuitMaxCooldownMsecs = 5 * 60 * 1000;
+// How often a process without the sync lock checks whether it can take over
+static const int kOwnershipRetryMsecs = 10000;
+
+static QString syncLockPath()
+{
+    QDir appDataDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    appDataDir.mkpath(".");
+    return appDataDir.filePath("foccuss_sync.lock");
+}
+
+static QString syncServerName()
+{
+    return QString("foccuss-sync-%1").arg(getuid());
+}
+
 ApiService::ApiService(Database* database, QObject *parent)
     : QObject(parent)
     , m_networkManager(new QNetworkAccessManager(this))
     , m_database(database)
+    , m_blockedAppOpsSupported(true)
+    , m_blockedAppOpsPushInFlight(false)
+    , m_blockedAppOpsPushQueued(false)
+    , m_cborSupported(false)
+    , m_deflateSupported(false)
+    , m_http2Direct(false)
+    , m_outboxFailures(0)
+    , m_pushReply(nullptr)
+    , m_pushEnabled(false)
+    , m_pushConnected(false)
+    , m_pushFailures(0)
+    , m_activeRequests(0)
+    , m_consecutiveFailures(0)
+    , m_circuitOpenings(0)
+    , m_circuitOpenUntil(0)
+    , m_ownerLock(syncLockPath())
+    , m_isSyncOwner(false)
+    , m_ownerServer(nullptr)
+    , m_ownerSocket(nullptr)
+    , m_blockedAppsFetchGeneration(0)
+    , m_stateFetchGeneration(0)
+    , m_stateSupported(true)
 {
+    if (m_database) {
+        m_cborSupported = m_database->getSetting("sync/cbor", false).toBool();
+        m_deflateSupported = m_database->getSetting("sync/deflate", false).toBool();
+    }
+
+    m_outboxDebounceTimer.setSingleShot(true);
+    m_outboxDebounceTimer.setInterval(kOutboxDebounceMsecs);
+    connect(&m_outboxDebounceTimer, &QTimer::timeout, this, &ApiService::flushOutbox);
+
+    m_outboxRetryTimer.setSingleShot(true);
+    connect(&m_outboxRetryTimer, &QTimer::timeout, this, &ApiService::flushOutbox);
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    bool hasReachability = QNetworkInformation::loadBackendByFeatures(QNetworkInformation::Feature::Reachability);
+#else
+    bool hasReachability = QNetworkInformation::load(QNetworkInformation::Feature::Reachability);
+#endif
+    if (hasReachability) {
+        connect(QNetworkInformation::instance(), &QNetworkInformation::reachabilityChanged,
+                this, &ApiService::onReachabilityChanged);
+    }
+    m_pushHeartbeatTimer.setSingleShot(true);
+    m_pushHeartbeatTimer.setInterval(kPushHeartbeatTimeoutMsecs);
+    connect(&m_pushHeartbeatTimer, &QTimer::timeout, this, &ApiService::onPushHeartbeatTimeout);
+
+    m_pushReconnectTimer.setSingleShot(true);
+    connect(&m_pushReconnectTimer, &QTimer::timeout, this, &ApiService::connectPushChannel);
+
+    m_circuitTimer.setSingleShot(true);
+    connect(&m_circuitTimer, &QTimer::timeout, this, &ApiService::pumpRequestQueue);
+
+    // A lock held by a live process never goes stale by age alone
+    m_ownerLock.setStaleLockTime(0);
+    m_ownershipTimer.setInterval(kOwnershipRetryMsecs);
+    connect(&m_ownershipTimer, &QTimer::timeout, this, &ApiService::claimSyncOwnership);
+
+    // Lets the other process reload what the owner applied
+    connect(this, &ApiService::dataFetched, this, [this](bool success) {
+        if (success && m_isSyncOwner) {
+            notifyPeers("fetched");
+        }
+    });
+
+    claimSyncOwnership();
 }
 
 ApiService::~ApiService()
 {
+    stopPushChannel();
+}
+
+QString ApiService::configuredBaseUrl(const Database* database)
+{
+    // Lets a local stand-in server be used without rebuilding
+    QString url = qEnvironmentVariable("FOCCUSS_API_URL");
+    if (url.isEmpty() && database) {
+        url = database->getSetting("sync/baseUrl").toString();
+    }
+    if (url.isEmpty()) {
+        url = kDefaultBaseUrl;
+    }
+
+    while (url.endsWith('/')) {
+        url.chop(1);
+    }
+
+    return url;
 }
 
 void ApiService::setBaseUrl(const QString& url)
 {
     m_baseUrl = url;
+    m_http2Direct = QUrl(m_baseUrl).scheme() == "http"
+                    && m_database->getSetting("sync/h2c", false).toBool();
+
+    // Open the keep-alive connection before the first request needs it
+    QUrl baseUrl(m_baseUrl);
+    if (baseUrl.scheme() == "https") {
+        m_networkManager->connectToHostEncrypted(baseUrl.host(), baseUrl.port(443));
+    } else if (baseUrl.isValid() && !baseUrl.host().isEmpty()) {
+        m_networkManager->connectToHost(baseUrl.host(), baseUrl.port(80));
+    }
+
+    // Uploads left over from a previous run
+    if (m_isSyncOwner && !m_baseUrl.isEmpty() && !m_database->getQueuedSyncs().isEmpty()) {
+        m_outboxDebounceTimer.start();
+    }
+}
+
+void ApiService::scheduleBlockedAppsSync()
+{
+    scheduleSync(kBlockedAppsResource);
+}
+
+void ApiService::scheduleTimeSettingsSync()
+{
+    scheduleSync(kTimeSettingsResource);
+}
+
+void ApiService::scheduleSync(const QString& resource)
+{
+    if (!m_database->queueSync(resource)) {
+        return;
+    }
+
+    if (!m_isSyncOwner) {
+        notifyOwner("flush");
+        return;
+    }
+
+    // A pending backoff is not shortened by more edits
+    if (!m_outboxRetryTimer.isActive()) {
+        m_outboxDebounceTimer.start();
+    }
+}
+
+void ApiService::flushOutbox()
+{
+    if (!m_isSyncOwner || m_baseUrl.isEmpty()) {
+        return;
+    }
+
+    const QList<QPair<QString, qint64>> queued = m_database->getQueuedSyncs();
+    for (const auto& entry : queued) {
+        if (m_outboxInFlight.contains(entry.first)) {
+            continue;
+        }
+
+        m_outboxInFlight.insert(entry.first, entry.second);
+        if (entry.first == kBlockedAppsResource) {
+            syncBlockedApps();
+        } else if (entry.first == kTimeSettingsResource) {
+            syncTimeSettings();
+        } else {
+            m_outboxInFlight.remove(entry.first);
+            m_database->clearQueuedSync(entry.first, entry.second);
+        }
+    }
+}
+
+void ApiService::finishQueuedSync(const QString& resource, bool success)
+{
+    // Uploads started directly rather than from the outbox are not tracked
+    auto it = m_outboxInFlight.find(resource);
+    if (it == m_outboxInFlight.end()) {
+        return;
+    }
+
+    const qint64 queuedAt = it.value();
+    m_outboxInFlight.erase(it);
+
+    if (!success) {
+        m_outboxFailures++;
+        int backoff = kOutboxMinBackoffMsecs << qMin(m_outboxFailures - 1, 10);
+        backoff = qMin(backoff, kOutboxMaxBackoffMsecs);
+        // Equal jitter: at least half the backoff, so a failing server is never
+        // retried immediately, while a fleet that went offline together does
+        // not return in step
+        backoff = backoff / 2 + int(QRandomGenerator::global()->bounded(backoff / 2 + 1));
+        m_outboxDebounceTimer.stop();
+        m_outboxRetryTimer.start(backoff);
+        logToFileAS(QString("Upload of %1 failed, retrying in %2 ms").arg(resource).arg(backoff));
+        return;
+    }
+
+    m_outboxFailures = 0;
+    if (!m_database->clearQueuedSync(resource, queuedAt)) {
+        // Edited again while uploading
+        m_outboxDebounceTimer.start();
+    }
+}
+
+void ApiService::onReachabilityChanged(QNetworkInformation::Reachability reachability)
+{
+    if (!m_isSyncOwner || reachability != QNetworkInformation::Reachability::Online) {
+        return;
+    }
+
+    // Skip the remaining backoff of a push channel that dropped while offline
+    if (m_pushEnabled && !m_pushReply) {
+        m_pushFailures = 0;
+        m_pushReconnectTimer.stop();
+        connectPushChannel();
+    }
+
+    if (!m_database->getQueuedSyncs().isEmpty()) {
+        m_outboxFailures = 0;
+        m_outboxRetryTimer.stop();
+        flushOutbox();
+    }
 }
 
 void ApiService::syncBlockedApps()
@@ -53,31 +298,88 @@ void ApiService::syncBlockedApps()
         return;
     }
 
-    QNetworkRequest request(QUrl(m_baseUrl + "/blocked-apps/linux"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    if (!m_blockedAppOpsSupported) {
+        syncBlockedAppsSnapshot();
+        return;
+    }
+
+    // One push at a time keeps the ops acknowledged in log order
+    if (m_blockedAppOpsPushInFlight) {
+        m_blockedAppOpsPushQueued = true;
+        return;
+    }
+
+    QList<BlockedAppOp> ops = m_database->getPendingBlockedAppOps(kMaxOpsPerPush);
+    if (ops.isEmpty()) {
+        finishQueuedSync(kBlockedAppsResource, true);
+        emit syncCompleted(true);
+        return;
+    }
+
+    QNetworkRequest request(QUrl(m_baseUrl + kBlockedAppOpsResource));
+
+    QJsonObject body;
+    body["clientId"] = m_database->clientId();
+    body["ops"] = blockedAppOpsToJson(ops);
+    QByteArray data = encodeBody(body, request);
+
+    m_blockedAppOpsPushInFlight = true;
+    m_blockedAppOpsPushQueued = false;
 
-    QJsonArray appsJson = blockedAppsToJson();
-    QJsonDocument doc(appsJson);
-    QByteArray data = doc.toJson();
+    const qint64 upToSeq = ops.last().seq;
+    sendRequest("POST", request, data, [this, upToSeq](QNetworkReply* reply) {
+        onBlockedAppOpsPushFinished(reply, upToSeq);
+    });
+}
+
+void ApiService::syncBlockedAppsSnapshot()
+{
+    QNetworkRequest request(QUrl(m_baseUrl + kBlockedAppsResource));
+    QByteArray data = encodeBody(blockedAppsToJson(), request);
 
-    QNetworkReply* reply = m_networkManager->post(request, data);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        onBlockedAppsSyncFinished(reply);
+    // The whole list goes up, so everything logged so far is covered
+    QList<BlockedAppOp> pending = m_database->getPendingBlockedAppOps(std::numeric_limits<int>::max());
+    const qint64 upToSeq = pending.isEmpty() ? 0 : pending.last().seq;
+
+    sendRequest("POST", request, data, [this, upToSeq](QNetworkReply* reply) {
+        onBlockedAppsSyncFinished(reply, upToSeq);
     });
 }
 
 void ApiService::fetchBlockedApps()
 {
+    if (!m_isSyncOwner) {
+        notifyOwner("fetch");
+        return;
+    }
+
     if (m_baseUrl.isEmpty()) {
         emit syncFailed("Base URL not set");
         return;
     }
 
-    QNetworkRequest request(QUrl(m_baseUrl + "/blocked-apps/linux"));
+    if (!m_blockedAppOpsSupported) {
+        QNetworkRequest request = createFetchRequest(kBlockedAppsResource);
 
-    QNetworkReply* reply = m_networkManager->get(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        onBlockedAppsFetchFinished(reply);
+        sendRequest("GET", request, QByteArray(), [this](QNetworkReply* reply) {
+            onBlockedAppsFetchFinished(reply);
+        });
+        return;
+    }
+
+    QUrl url(m_baseUrl + kBlockedAppOpsResource);
+    QString cursor = m_database->getSetting(QString("sync/cursor") + kBlockedAppOpsResource).toString();
+    if (!cursor.isEmpty()) {
+        QUrlQuery query(url);
+        query.addQueryItem("since", cursor);
+        url.setQuery(query);
+    }
+
+    QNetworkRequest request(url);
+    request.setRawHeader("Accept", kAcceptHeader);
+
+    sendRequest("GET", request, QByteArray(), [this](QNetworkReply* reply) {
+        onBlockedAppOpsPullFinished(reply);
     });
 }
 
@@ -88,41 +390,75 @@ void ApiService::syncTimeSettings()
         return;
     }
 
-    QNetworkRequest request(QUrl(m_baseUrl + "/block-time-settings/linux"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-
-    QJsonObject settingsJson = timeSettingsToJson();
-    QJsonDocument doc(settingsJson);
-    QByteArray data = doc.toJson();
+    QNetworkRequest request(QUrl(m_baseUrl + kTimeSettingsResource));
+    QByteArray data = encodeBody(timeSettingsToJson(), request);
 
-    QNetworkReply* reply = m_networkManager->post(request, data);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    sendRequest("POST", request, data, [this](QNetworkReply* reply) {
         onTimeSettingsSyncFinished(reply);
     });
 }
 
 void ApiService::fetchTimeSettings()
 {
+    if (!m_isSyncOwner) {
+        notifyOwner("fetch");
+        return;
+    }
+
     if (m_baseUrl.isEmpty()) {
         emit syncFailed("Base URL not set");
         return;
     }
 
-    QNetworkRequest request(QUrl(m_baseUrl + "/block-time-settings/linux"));
+    QNetworkRequest request = createFetchRequest(kTimeSettingsResource);
 
-    QNetworkReply* reply = m_networkManager->get(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    sendRequest("GET", request, QByteArray(), [this](QNetworkReply* reply) {
         onTimeSettingsFetchFinished(reply);
     });
 }
 
-void ApiService::onBlockedAppsSyncFinished(QNetworkReply* reply)
+void ApiService::fetchState()
+{
+    if (!m_isSyncOwner) {
+        notifyOwner("fetch");
+        return;
+    }
+
+    if (m_baseUrl.isEmpty()) {
+        emit syncFailed("Base URL not set");
+        return;
+    }
+
+    if (!m_stateSupported) {
+        fetchBlockedApps();
+        fetchTimeSettings();
+        return;
+    }
+
+    QNetworkRequest request = createFetchRequest(kStateResource);
+
+    sendRequest("GET", request, QByteArray(), [this](QNetworkReply* reply) {
+        onStateFetchFinished(reply);
+    });
+}
+
+void ApiService::onBlockedAppsSyncFinished(QNetworkReply* reply, qint64 upToSeq)
 {
     reply->deleteLater();
 
+    if (isEncodingRejected(reply)) {
+        syncBlockedApps();
+        return;
+    }
+
     if (reply->error() == QNetworkReply::NoError) {
+        storeValidators(kBlockedAppsResource, reply);
+        m_database->markBlockedAppOpsSynced(upToSeq);
+        m_database->compactBlockedAppOps();
+        finishQueuedSync(kBlockedAppsResource, true);
         emit syncCompleted(true);
     } else {
+        finishQueuedSync(kBlockedAppsResource, false);
         emit syncFailed(reply->errorString());
     }
 }
@@ -132,27 +468,251 @@ void ApiService::onBlockedAppsFetchFinished(QNetworkReply* reply)
     reply->deleteLater();
 
     if (reply->error() == QNetworkReply::NoError) {
-        QByteArray data = reply->readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(data);
-        
-        if (doc.isArray()) {
-            processBlockedAppsResponse(doc.array());
-            emit dataFetched(true);
-        } else {
-            emit dataFetched(false);
+        if (isNotModified(reply)) {
+            logToFileAS("Blocked apps unchanged on the server");
+            return;
         }
+
+        learnServerCapabilities(reply);
+
+        const QByteArray data = reply->readAll();
+        const bool isCbor = reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("application/cbor");
+        const QByteArray etag = reply->rawHeader("ETag");
+        const QByteArray revision = reply->rawHeader("X-Revision");
+        const QHash<QString, BlockedAppOp> current = m_database->getBlockedAppStates();
+        const int generation = ++m_blockedAppsFetchGeneration;
+
+        // Parsing and diffing a large list stays off the GUI thread; only the
+        // resulting changes come back to be written
+        QPointer<ApiService> self(this);
+        QThreadPool::globalInstance()->start([self, data, isCbor, current, etag, revision, generation]() {
+            QString error;
+            const QJsonValue body = decodePayload(data, isCbor, &error);
+            const bool ok = body.isArray();
+            const QList<BlockedAppOp> changes = ok ? diffBlockedApps(body.toArray(), current)
+                                                   : QList<BlockedAppOp>();
+
+            QMetaObject::invokeMethod(QCoreApplication::instance(),
+                                      [self, changes, ok, error, etag, revision, generation]() {
+                if (self) {
+                    self->applyFetchedBlockedApps(changes, ok, error, etag, revision, generation);
+                }
+            }, Qt::QueuedConnection);
+        });
     } else {
         emit syncFailed(reply->errorString());
     }
 }
 
+void ApiService::onStateFetchFinished(QNetworkReply* reply)
+{
+    reply->deleteLater();
+
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 404) {
+        logToFileAS("Server has no combined state endpoint, fetching resources separately");
+        m_stateSupported = false;
+        fetchState();
+        return;
+    }
+
+    if (reply->error() != QNetworkReply::NoError) {
+        emit syncFailed(reply->errorString());
+        return;
+    }
+
+    if (isNotModified(reply)) {
+        logToFileAS("State unchanged on the server");
+        return;
+    }
+
+    learnServerCapabilities(reply);
+
+    const QByteArray data = reply->readAll();
+    const bool isCbor = reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("application/cbor");
+    const QByteArray etag = reply->rawHeader("ETag");
+    const QByteArray revision = reply->rawHeader("X-Revision");
+    const QHash<QString, BlockedAppOp> current = m_database->getBlockedAppStates();
+    const int generation = ++m_stateFetchGeneration;
+
+    QPointer<ApiService> self(this);
+    QThreadPool::globalInstance()->start([self, data, isCbor, current, etag, revision, generation]() {
+        QString error;
+        const QJsonValue body = decodePayload(data, isCbor, &error);
+        const QJsonObject state = body.toObject();
+        const bool ok = body.isObject() && state["blockedApps"].isArray() && state["timeSettings"].isObject();
+
+        QList<BlockedAppOp> changes;
+        if (ok) {
+            changes = diffBlockedApps(state["blockedApps"].toArray(), current);
+        }
+        const QJsonObject timeSettings = state["timeSettings"].toObject();
+        const QString cursor = state["cursor"].toVariant().toString();
+
+        QMetaObject::invokeMethod(QCoreApplication::instance(),
+                                  [self, changes, timeSettings, cursor, ok, error, etag, revision, generation]() {
+            if (self) {
+                self->applyFetchedState(changes, timeSettings, cursor, ok, error, etag, revision, generation);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ApiService::applyFetchedState(const QList<BlockedAppOp>& changes, const QJsonObject& timeSettings,
+                                   const QString& cursor, bool ok, const QString& error,
+                                   const QByteArray& etag, const QByteArray& revision, int generation)
+{
+    if (!error.isEmpty()) {
+        logToFileAS(error);
+    }
+
+    if (generation != m_stateFetchGeneration) {
+        return;
+    }
+
+    if (!ok || !m_database->applyState(changes, timeSettingsFromJson(timeSettings))) {
+        emit dataFetched(false);
+        return;
+    }
+
+    storeValidators(kStateResource, etag, revision);
+    // The snapshot includes every op up to here, so incremental pulls resume from it
+    if (!cursor.isEmpty()) {
+        m_database->setSetting(QString("sync/cursor") + kBlockedAppOpsResource, cursor);
+    }
+
+    emit dataFetched(true);
+}
+
+void ApiService::applyFetchedBlockedApps(const QList<BlockedAppOp>& changes, bool ok, const QString& error,
+                                         const QByteArray& etag, const QByteArray& revision, int generation)
+{
+    if (!error.isEmpty()) {
+        logToFileAS(error);
+    }
+
+    // A newer fetch was diffed against fresher rows
+    if (generation != m_blockedAppsFetchGeneration) {
+        return;
+    }
+
+    if (!ok || !m_database->applyBlockedAppChanges(changes)) {
+        emit dataFetched(false);
+        return;
+    }
+
+    storeValidators(kBlockedAppsResource, etag, revision);
+
+    if (!changes.isEmpty()) {
+        emit dataFetched(true);
+    }
+}
+
+void ApiService::onBlockedAppOpsPushFinished(QNetworkReply* reply, qint64 upToSeq)
+{
+    reply->deleteLater();
+    m_blockedAppOpsPushInFlight = false;
+
+    if (isEncodingRejected(reply)) {
+        syncBlockedApps();
+        return;
+    }
+
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 404) {
+        logToFileAS("Server has no blocked-app op log, falling back to full uploads");
+        m_blockedAppOpsSupported = false;
+        syncBlockedApps();
+        return;
+    }
+
+    if (reply->error() != QNetworkReply::NoError) {
+        m_blockedAppOpsPushQueued = false;
+        finishQueuedSync(kBlockedAppsResource, false);
+        emit syncFailed(reply->errorString());
+        return;
+    }
+
+    m_database->markBlockedAppOpsSynced(upToSeq);
+    m_database->compactBlockedAppOps();
+
+    // Drain what was queued meanwhile or did not fit into this batch
+    if (m_blockedAppOpsPushQueued || !m_database->getPendingBlockedAppOps(1).isEmpty()) {
+        syncBlockedApps();
+        return;
+    }
+
+    finishQueuedSync(kBlockedAppsResource, true);
+    emit syncCompleted(true);
+}
+
+void ApiService::onBlockedAppOpsPullFinished(QNetworkReply* reply)
+{
+    reply->deleteLater();
+
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 404) {
+        logToFileAS("Server has no blocked-app op log, falling back to full downloads");
+        m_blockedAppOpsSupported = false;
+        fetchBlockedApps();
+        return;
+    }
+
+    if (reply->error() != QNetworkReply::NoError) {
+        emit syncFailed(reply->errorString());
+        return;
+    }
+
+    QJsonValue body = decodeBody(reply);
+    if (!body.isObject()) {
+        emit dataFetched(false);
+        return;
+    }
+
+    QJsonObject response = body.toObject();
+    const QString ownId = m_database->clientId();
+
+    // Our own ops echo back through the server; they are already applied
+    QList<BlockedAppOp> ops;
+    const QJsonArray opsJson = response["ops"].toArray();
+    for (const QJsonValue& value : opsJson) {
+        BlockedAppOp op = blockedAppOpFromJson(value.toObject());
+        if (!op.appPath.isEmpty() && op.origin != ownId) {
+            ops.append(op);
+        }
+    }
+
+    if (!ops.isEmpty() && !m_database->applyBlockedAppOps(ops)) {
+        emit dataFetched(false);
+        return;
+    }
+
+    QString cursor = response["cursor"].toVariant().toString();
+    if (!cursor.isEmpty()) {
+        m_database->setSetting(QString("sync/cursor") + kBlockedAppOpsResource, cursor);
+    }
+
+    if (!ops.isEmpty()) {
+        emit dataFetched(true);
+    }
+
+    if (response["hasMore"].toBool()) {
+        fetchBlockedApps();
+    }
+}
+
 void ApiService::onTimeSettingsSyncFinished(QNetworkReply* reply)
 {
     reply->deleteLater();
 
+    if (isEncodingRejected(reply)) {
+        syncTimeSettings();
+        return;
+    }
+
     if (reply->error() == QNetworkReply::NoError) {
+        storeValidators(kTimeSettingsResource, reply);
+        finishQueuedSync(kTimeSettingsResource, true);
         emit syncCompleted(true);
     } else {
+        finishQueuedSync(kTimeSettingsResource, false);
         emit syncFailed(reply->errorString());
     }
 }
@@ -162,11 +722,16 @@ void ApiService::onTimeSettingsFetchFinished(QNetworkReply* reply)
     reply->deleteLater();
 
     if (reply->error() == QNetworkReply::NoError) {
-        QByteArray data = reply->readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(data);
+        if (isNotModified(reply)) {
+            logToFileAS("Time settings unchanged on the server");
+            return;
+        }
+
+        QJsonValue body = decodeBody(reply);
         
-        if (doc.isObject()) {
-            processTimeSettingsResponse(doc.object());
+        if (body.isObject()) {
+            processTimeSettingsResponse(body.toObject());
+            storeValidators(kTimeSettingsResource, reply);
             emit dataFetched(true);
         } else {
             emit dataFetched(false);
@@ -176,6 +741,608 @@ void ApiService::onTimeSettingsFetchFinished(QNetworkReply* reply)
     }
 }
 
+void ApiService::sendRequest(const QByteArray& verb, const QNetworkRequest& request, const QByteArray& body,
+                             const std::function<void(QNetworkReply*)>& onFinished)
+{
+    // A queued GET for the same URL will already bring the newest state
+    if (verb == "GET") {
+        for (const PendingRequest& pending : std::as_const(m_requestQueue)) {
+            if (pending.verb == verb && pending.request.url() == request.url()) {
+                return;
+            }
+        }
+    }
+
+    m_requestQueue.append({ verb, request, body, onFinished, 1 });
+    pumpRequestQueue();
+}
+
+void ApiService::pumpRequestQueue()
+{
+    while (!m_requestQueue.isEmpty() && m_activeRequests < kMaxConcurrentRequests) {
+        if (m_circuitOpenUntil > 0) {
+            qint64 remaining = m_circuitOpenUntil - QDateTime::currentMSecsSinceEpoch();
+            if (remaining > 0) {
+                // Open: nothing goes out until the cooldown ends
+                m_circuitTimer.start(int(remaining));
+                return;
+            }
+            // Half-open: a single probe decides whether to close again
+            if (m_activeRequests > 0) {
+                return;
+            }
+            startRequest(m_requestQueue.takeFirst());
+            return;
+        }
+
+        startRequest(m_requestQueue.takeFirst());
+    }
+}
+
+void ApiService::startRequest(PendingRequest pending)
+{
+    pending.request.setTransferTimeout(kRequestTimeoutMsecs);
+    // HTTP/2 is only negotiated through TLS ALPN; over plain http it takes
+    // prior knowledge (h2c), which an HTTP/1.1-only server would reject.
+    // Otherwise requests share the pooled HTTP/1.1 keep-alive connections.
+    if (m_http2Direct) {
+        pending.request.setAttribute(QNetworkRequest::Http2DirectAttribute, true);
+    } else {
+        pending.request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    }
+
+    QNetworkReply* reply = pending.verb == "GET"
+                               ? m_networkManager->get(pending.request)
+                               : m_networkManager->sendCustomRequest(pending.request, pending.verb, pending.body);
+    m_activeRequests++;
+
+    connect(reply, &QNetworkReply::finished, this, [this, reply, pending]() {
+        onRequestFinished(reply, pending);
+    });
+}
+
+void ApiService::onRequestFinished(QNetworkReply* reply, PendingRequest pending)
+{
+    m_activeRequests--;
+
+    if (!isTransientFailure(reply)) {
+        if (m_circuitOpenUntil > 0) {
+            logToFileAS("Server reachable again, closing the circuit");
+        }
+        m_consecutiveFailures = 0;
+        m_circuitOpenings = 0;
+        m_circuitOpenUntil = 0;
+
+        pending.onFinished(reply);
+        pumpRequestQueue();
+        return;
+    }
+
+    m_consecutiveFailures++;
+    // A failed half-open probe reopens with a longer cooldown; stragglers
+    // failing while the circuit is already open do not extend it
+    const bool isOpen = m_circuitOpenUntil > QDateTime::currentMSecsSinceEpoch();
+    if (!isOpen && (m_circuitOpenUntil > 0 || m_consecutiveFailures >= kCircuitFailureThreshold)) {
+        openCircuit();
+    }
+
+    // Uploads are retried by the outbox; only reads are replayed here
+    if (pending.verb == "GET" && pending.attempt < kMaxRequestAttempts) {
+        int delay = retryDelay(reply, pending.attempt);
+        pending.attempt++;
+        reply->deleteLater();
+
+        QTimer::singleShot(delay, this, [this, pending]() {
+            m_requestQueue.prepend(pending);
+            pumpRequestQueue();
+        });
+    } else {
+        pending.onFinished(reply);
+    }
+
+    pumpRequestQueue();
+}
+
+bool ApiService::isTransientFailure(QNetworkReply* reply) const
+{
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 408 || status == 429 || status >= 500) {
+        return true;
+    }
+
+    switch (reply->error()) {
+        case QNetworkReply::ConnectionRefusedError:
+        case QNetworkReply::RemoteHostClosedError:
+        case QNetworkReply::HostNotFoundError:
+        case QNetworkReply::TimeoutError:
+        case QNetworkReply::OperationCanceledError:
+        case QNetworkReply::TemporaryNetworkFailureError:
+        case QNetworkReply::NetworkSessionFailedError:
+        case QNetworkReply::UnknownNetworkError:
+        case QNetworkReply::ProxyTimeoutError:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int ApiService::retryDelay(QNetworkReply* reply, int attempt) const
+{
+    // Retry-After in seconds wins over our own schedule
+    bool ok = false;
+    int retryAfter = reply->rawHeader("Retry-After").toInt(&ok);
+    if (ok && retryAfter > 0) {
+        return qMin(retryAfter * 1000, kCircuitMaxCooldownMsecs);
+    }
+
+    int delay = kRetryBaseMsecs << (attempt - 1);
+    return delay / 2 + int(QRandomGenerator::global()->bounded(delay / 2 + 1));
+}
+
+void ApiService::openCircuit()
+{
+    m_circuitOpenings++;
+    int cooldown = qMin(kCircuitMinCooldownMsecs << qMin(m_circuitOpenings - 1, 10), kCircuitMaxCooldownMsecs);
+    cooldown = cooldown / 2 + int(QRandomGenerator::global()->bounded(cooldown / 2 + 1));
+
+    m_circuitOpenUntil = QDateTime::currentMSecsSinceEpoch() + cooldown;
+    m_circuitTimer.start(cooldown);
+    logToFileAS(QString("Server unreachable, holding requests for %1 ms").arg(cooldown));
+}
+
+void ApiService::startPushChannel()
+{
+    if (m_pushEnabled) {
+        return;
+    }
+
+    m_pushEnabled = true;
+    m_pushFailures = 0;
+    connectPushChannel();
+}
+
+void ApiService::stopPushChannel()
+{
+    m_pushEnabled = false;
+    m_pushReconnectTimer.stop();
+    m_pushHeartbeatTimer.stop();
+
+    if (m_pushReply) {
+        QNetworkReply* reply = m_pushReply;
+        m_pushReply = nullptr;
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+    m_pushConnected = false;
+}
+
+bool ApiService::isPushConnected() const
+{
+    return m_pushConnected;
+}
+
+void ApiService::connectPushChannel()
+{
+    if (!m_isSyncOwner || !m_pushEnabled || m_pushReply || m_baseUrl.isEmpty()) {
+        return;
+    }
+
+    QNetworkRequest request(QUrl(m_baseUrl + kPushResource));
+    request.setRawHeader("Accept", "text/event-stream");
+    request.setRawHeader("Cache-Control", "no-cache");
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    if (!m_pushLastEventId.isEmpty()) {
+        request.setRawHeader("Last-Event-ID", m_pushLastEventId);
+    }
+
+    m_pushBuffer.clear();
+    m_pushEventName.clear();
+    m_pushEventData.clear();
+
+    m_pushReply = m_networkManager->get(request);
+    connect(m_pushReply, &QNetworkReply::readyRead, this, &ApiService::onPushReadyRead);
+    connect(m_pushReply, &QNetworkReply::finished, this, &ApiService::onPushFinished);
+
+    m_pushHeartbeatTimer.start();
+}
+
+void ApiService::onPushReadyRead()
+{
+    if (!m_pushReply) {
+        return;
+    }
+
+    if (!m_pushConnected) {
+        if (m_pushReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
+            return;
+        }
+
+        m_pushConnected = true;
+        logToFileAS("Push channel connected");
+
+        // Changes made while disconnected produced no events; catch up once
+        if (m_pushFailures > 0) {
+            fetchState();
+        }
+        m_pushFailures = 0;
+    }
+
+    m_pushHeartbeatTimer.start();
+    m_pushBuffer.append(m_pushReply->readAll());
+
+    int lineEnd;
+    while ((lineEnd = m_pushBuffer.indexOf('\n')) >= 0) {
+        QByteArray line = m_pushBuffer.left(lineEnd);
+        m_pushBuffer.remove(0, lineEnd + 1);
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        processPushLine(line);
+    }
+}
+
+void ApiService::processPushLine(const QByteArray& line)
+{
+    // text/event-stream: fields accumulate until a blank line dispatches
+    if (line.isEmpty()) {
+        if (!m_pushEventName.isEmpty() || !m_pushEventData.isEmpty()) {
+            dispatchPushEvent(m_pushEventName.isEmpty() ? QByteArray("message") : m_pushEventName,
+                              m_pushEventData);
+        }
+        m_pushEventName.clear();
+        m_pushEventData.clear();
+        return;
+    }
+
+    // Comment lines double as heartbeats
+    if (line.startsWith(':')) {
+        return;
+    }
+
+    int colon = line.indexOf(':');
+    QByteArray field = colon < 0 ? line : line.left(colon);
+    QByteArray value = colon < 0 ? QByteArray() : line.mid(colon + 1);
+    if (value.startsWith(' ')) {
+        value.remove(0, 1);
+    }
+
+    if (field == "event") {
+        m_pushEventName = value;
+    } else if (field == "data") {
+        if (!m_pushEventData.isEmpty()) {
+            m_pushEventData.append('\n');
+        }
+        m_pushEventData.append(value);
+    } else if (field == "id") {
+        m_pushLastEventId = value;
+    }
+}
+
+void ApiService::dispatchPushEvent(const QByteArray& event, const QByteArray& data)
+{
+    Q_UNUSED(data);
+
+    // Events only name what changed; the data itself comes from a normal fetch
+    if (event == "blocked-apps") {
+        fetchBlockedApps();
+    } else if (event == "block-time-settings") {
+        fetchTimeSettings();
+    } else if (event == "policy") {
+        fetchState();
+    }
+}
+
+void ApiService::onPushHeartbeatTimeout()
+{
+    if (!m_pushReply) {
+        return;
+    }
+
+    logToFileAS("Push channel heartbeat missed, reconnecting");
+    // Finishes the reply, which schedules the reconnect
+    m_pushReply->abort();
+}
+
+void ApiService::onPushFinished()
+{
+    if (!m_pushReply) {
+        return;
+    }
+
+    QNetworkReply* reply = m_pushReply;
+    m_pushReply = nullptr;
+    reply->deleteLater();
+    m_pushHeartbeatTimer.stop();
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const bool wasConnected = m_pushConnected;
+    m_pushConnected = false;
+
+    if (!m_pushEnabled) {
+        return;
+    }
+
+    if (status == 404) {
+        logToFileAS("Server has no push channel, relying on fetches only");
+        m_pushEnabled = false;
+        return;
+    }
+
+    if (wasConnected) {
+        logToFileAS("Push channel closed: " + reply->errorString());
+    }
+
+    m_pushFailures++;
+    int backoff = kPushMinBackoffMsecs << qMin(m_pushFailures - 1, 10);
+    backoff = qMin(backoff, kPushMaxBackoffMsecs);
+    // Jitter spreads the reconnects of every client after a server restart
+    backoff = backoff / 2 + int(QRandomGenerator::global()->bounded(backoff / 2 + 1));
+    m_pushReconnectTimer.start(backoff);
+}
+
+bool ApiService::isSyncOwner() const
+{
+    return m_isSyncOwner;
+}
+
+void ApiService::claimSyncOwnership()
+{
+    if (m_isSyncOwner) {
+        return;
+    }
+
+    if (!m_ownerLock.tryLock(0)) {
+        // Another process syncs; stay connected so nudges reach it
+        if (!m_ownerSocket) {
+            m_ownerSocket = new QLocalSocket(this);
+            connect(m_ownerSocket, &QLocalSocket::connected, this, [this]() {
+                // Work queued while there was no connection
+                if (!m_database->getQueuedSyncs().isEmpty()) {
+                    notifyOwner("flush");
+                }
+            });
+            connect(m_ownerSocket, &QLocalSocket::readyRead, this, &ApiService::onOwnerReadyRead);
+            // The owner exited, releasing its lock
+            connect(m_ownerSocket, &QLocalSocket::disconnected, this, &ApiService::claimSyncOwnership);
+        }
+        if (m_ownerSocket->state() == QLocalSocket::UnconnectedState) {
+            m_ownerSocket->connectToServer(syncServerName());
+        }
+        m_ownershipTimer.start();
+        return;
+    }
+
+    m_isSyncOwner = true;
+    m_ownershipTimer.stop();
+    if (m_ownerSocket) {
+        m_ownerSocket->disconnect(this);
+        m_ownerSocket->abort();
+        m_ownerSocket->deleteLater();
+        m_ownerSocket = nullptr;
+    }
+
+    // Holding the lock, any leftover socket belongs to a dead owner
+    QLocalServer::removeServer(syncServerName());
+    m_ownerServer = new QLocalServer(this);
+    m_ownerServer->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_ownerServer, &QLocalServer::newConnection, this, &ApiService::onPeerConnected);
+    if (!m_ownerServer->listen(syncServerName())) {
+        logToFileAS("Sync owner socket unavailable: " + m_ownerServer->errorString());
+    }
+    logToFileAS("This process now owns sync");
+
+    // Take over from a previous owner mid-session
+    if (!m_baseUrl.isEmpty()) {
+        fetchState();
+        connectPushChannel();
+        if (!m_database->getQueuedSyncs().isEmpty()) {
+            m_outboxDebounceTimer.start();
+        }
+    }
+}
+
+void ApiService::onPeerConnected()
+{
+    while (QLocalSocket* peer = m_ownerServer->nextPendingConnection()) {
+        m_peers.append(peer);
+
+        connect(peer, &QLocalSocket::readyRead, this, [this, peer]() {
+            while (peer->canReadLine()) {
+                const QByteArray message = peer->readLine().trimmed();
+                if (message == "flush") {
+                    // The peer already queued the work in the outbox
+                    if (!m_outboxRetryTimer.isActive()) {
+                        m_outboxDebounceTimer.start();
+                    }
+                } else if (message == "fetch") {
+                    fetchState();
+                }
+            }
+        });
+        connect(peer, &QLocalSocket::disconnected, this, [this, peer]() {
+            m_peers.removeOne(peer);
+            peer->deleteLater();
+        });
+    }
+}
+
+void ApiService::onOwnerReadyRead()
+{
+    while (m_ownerSocket && m_ownerSocket->canReadLine()) {
+        if (m_ownerSocket->readLine().trimmed() == "fetched") {
+            emit dataFetched(true);
+        }
+    }
+}
+
+void ApiService::notifyOwner(const QByteArray& message)
+{
+    // Outbox entries are in the database, so a nudge lost while the owner
+    // is unreachable is made up for when the connection comes back
+    if (m_ownerSocket && m_ownerSocket->state() == QLocalSocket::ConnectedState) {
+        m_ownerSocket->write(message + '\n');
+    }
+}
+
+void ApiService::notifyPeers(const QByteArray& message)
+{
+    for (QLocalSocket* peer : std::as_const(m_peers)) {
+        peer->write(message + '\n');
+    }
+}
+
+QNetworkRequest ApiService::createFetchRequest(const QString& resource) const
+{
+    QUrl url(m_baseUrl + resource);
+
+    // A 200 is always the complete document; since= only lets the server
+    // answer 304 without comparing bodies
+    QString revision = m_database->getSetting("sync/revision" + resource).toString();
+    if (!revision.isEmpty()) {
+        QUrlQuery query(url);
+        query.addQueryItem("since", revision);
+        url.setQuery(query);
+    }
+
+    QNetworkRequest request(url);
+    request.setRawHeader("Accept", kAcceptHeader);
+
+    QByteArray etag = m_database->getSetting("sync/etag" + resource).toByteArray();
+    if (!etag.isEmpty()) {
+        request.setRawHeader("If-None-Match", etag);
+    }
+
+    return request;
+}
+
+QByteArray ApiService::encodeBody(const QJsonValue& body, QNetworkRequest& request) const
+{
+    QByteArray data;
+    if (m_cborSupported) {
+        data = QCborValue::fromJsonValue(body).toCbor();
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/cbor");
+    } else {
+        data = body.isArray() ? QJsonDocument(body.toArray()).toJson(QJsonDocument::Compact)
+                              : QJsonDocument(body.toObject()).toJson(QJsonDocument::Compact);
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    }
+    request.setRawHeader("Accept", kAcceptHeader);
+
+    if (m_deflateSupported && data.size() >= kCompressThreshold) {
+        // qCompress emits a zlib stream behind a 4-byte length prefix; the
+        // zlib stream alone is what HTTP calls "deflate"
+        data = qCompress(data).mid(4);
+        request.setRawHeader("Content-Encoding", "deflate");
+    }
+
+    return data;
+}
+
+QJsonValue ApiService::decodeBody(QNetworkReply* reply)
+{
+    // QNetworkAccessManager already undoes gzip/deflate response encodings
+    learnServerCapabilities(reply);
+
+    const QByteArray data = reply->readAll();
+    const QString contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+
+    QString error;
+    QJsonValue body = decodePayload(data, contentType.startsWith("application/cbor"), &error);
+    if (!error.isEmpty()) {
+        logToFileAS(error);
+    }
+    return body;
+}
+
+// Also runs on pool threads, so problems are returned rather than logged
+QJsonValue ApiService::decodePayload(const QByteArray& data, bool isCbor, QString* error)
+{
+    if (isCbor) {
+        QCborParserError parseError;
+        QCborValue value = QCborValue::fromCbor(data, &parseError);
+        if (parseError.error != QCborError::NoError) {
+            *error = "Invalid CBOR response: " + parseError.errorString();
+            return QJsonValue(QJsonValue::Undefined);
+        }
+        return value.toJsonValue();
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
+    if (doc.isArray())
+        return doc.array();
+    if (doc.isObject())
+        return doc.object();
+
+    if (parseError.error != QJsonParseError::NoError) {
+        *error = "Invalid JSON response: " + parseError.errorString();
+    }
+    return QJsonValue(QJsonValue::Undefined);
+}
+
+void ApiService::learnServerCapabilities(QNetworkReply* reply)
+{
+    // A CBOR reply proves the server speaks it; RFC 7694 lets it advertise
+    // the request encodings it accepts through Accept-Encoding
+    if (!m_cborSupported
+        && reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("application/cbor")) {
+        m_cborSupported = true;
+        m_database->setSetting("sync/cbor", true);
+    }
+
+    if (!m_deflateSupported && reply->rawHeader("Accept-Encoding").contains("deflate")) {
+        m_deflateSupported = true;
+        m_database->setSetting("sync/deflate", true);
+    }
+}
+
+bool ApiService::isEncodingRejected(QNetworkReply* reply)
+{
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 415)
+        return false;
+
+    const QNetworkRequest request = reply->request();
+    bool downgraded = false;
+
+    if (request.hasRawHeader("Content-Encoding") && m_deflateSupported) {
+        m_deflateSupported = false;
+        m_database->setSetting("sync/deflate", false);
+        downgraded = true;
+    }
+    if (request.header(QNetworkRequest::ContentTypeHeader).toString() == "application/cbor" && m_cborSupported) {
+        m_cborSupported = false;
+        m_database->setSetting("sync/cbor", false);
+        downgraded = true;
+    }
+
+    if (downgraded) {
+        logToFileAS("Server rejected the request encoding, retrying with plain JSON");
+    }
+
+    return downgraded;
+}
+
+bool ApiService::isNotModified(QNetworkReply* reply) const
+{
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304;
+}
+
+void ApiService::storeValidators(const QString& resource, QNetworkReply* reply)
+{
+    storeValidators(resource, reply->rawHeader("ETag"), reply->rawHeader("X-Revision"));
+}
+
+void ApiService::storeValidators(const QString& resource, const QByteArray& etag, const QByteArray& revision)
+{
+    if (!etag.isEmpty()) {
+        m_database->setSetting("sync/etag" + resource, QString::fromLatin1(etag));
+    }
+    if (!revision.isEmpty()) {
+        m_database->setSetting("sync/revision" + resource, QString::fromLatin1(revision));
+    }
+}
+
 QJsonArray ApiService::blockedAppsToJson() const
 {
     QJsonArray appsArray;
@@ -192,6 +1359,35 @@ QJsonArray ApiService::blockedAppsToJson() const
     return appsArray;
 }
 
+QJsonArray ApiService::blockedAppOpsToJson(const QList<BlockedAppOp>& ops) const
+{
+    QJsonArray opsArray;
+
+    for (const BlockedAppOp& op : ops) {
+        QJsonObject opObj;
+        opObj["appPath"] = op.appPath;
+        opObj["appName"] = op.appName;
+        opObj["op"] = op.blocked ? "add" : "remove";
+        opObj["lamport"] = op.lamport;
+        opObj["origin"] = op.origin;
+        opsArray.append(opObj);
+    }
+
+    return opsArray;
+}
+
+BlockedAppOp ApiService::blockedAppOpFromJson(const QJsonObject& opObj) const
+{
+    BlockedAppOp op;
+    op.seq = 0;
+    op.appPath = opObj["appPath"].toString();
+    op.appName = opObj["appName"].toString();
+    op.blocked = opObj["op"].toString() == "add";
+    op.lamport = opObj["lamport"].toVariant().toLongLong();
+    op.origin = opObj["origin"].toString();
+    return op;
+}
+
 QJsonObject ApiService::timeSettingsToJson() const
 {
     QJsonObject settingsObj;
@@ -218,12 +1414,10 @@ QJsonObject ApiService::timeSettingsToJson() const
     return settingsObj;
 }
 
-void ApiService::processBlockedAppsResponse(const QJsonArray& apps)
+QList<BlockedAppOp> ApiService::diffBlockedApps(const QJsonArray& apps, const QHash<QString, BlockedAppOp>& current)
 {
-    QList<std::shared_ptr<AppModel>> currentApps = m_database->getBlockedApps();
-    for (const auto& app : currentApps) {
-        m_database->removeBlockedApp(app->getPath());
-    }
+    QList<BlockedAppOp> changes;
+    QSet<QString> listed;
 
     for (const QJsonValue& appValue : apps) {
         QJsonObject appObj = appValue.toObject();
@@ -232,15 +1426,40 @@ void ApiService::processBlockedAppsResponse(const QJsonArray& apps)
         if (path.isEmpty() || name.isEmpty())
             continue;
 
-        int isBlocked = appObj["isBlocked"].toInt();
-        if (isBlocked == 1)
-            m_database->addBlockedApp(path, name);
-        else
-            m_database->removeBlockedApp(path);
+        bool blocked = appObj["isBlocked"].toInt() == 1;
+        listed.insert(path);
+
+        // Servers with the op log stamp each row; older ones send no clock (0)
+        const qint64 lamport = appObj["lamport"].toVariant().toLongLong();
+        const QString origin = appObj["origin"].toString();
+
+        auto it = current.constFind(path);
+        if (it != current.constEnd() && it->appName == name && it->blocked == blocked)
+            continue;
+        if (it != current.constEnd() && lamport > 0
+            && (lamport < it->lamport || (lamport == it->lamport && origin <= it->origin)))
+            continue;
+
+        changes.append({ 0, path, name, blocked, lamport, origin });
     }
+
+    // Blocked locally but missing from the document means unblocked. Paths
+    // with a local op not yet uploaded are left alone when this is written.
+    for (auto it = current.constBegin(); it != current.constEnd(); ++it) {
+        if (it->blocked && !listed.contains(it.key())) {
+            changes.append({ 0, it.key(), it->appName, false, 0, QString() });
+        }
+    }
+
+    return changes;
 }
 
 void ApiService::processTimeSettingsResponse(const QJsonObject& settings)
+{
+    m_database->updateBlockTimeSettings(timeSettingsFromJson(settings));
+}
+
+std::shared_ptr<BlockTimeSettingsModel> ApiService::timeSettingsFromJson(const QJsonObject& settings) const
 {
     QTime startTime(settings["startHour"].toInt(), settings["startMinute"].toInt());
     QTime endTime(settings["endHour"].toInt(), settings["endMinute"].toInt());
@@ -257,6 +1476,5 @@ void ApiService::processTimeSettingsResponse(const QJsonObject& settings)
     
     bool isActive = settings["isActive"].toBool();
     
-    auto timeSettings = std::make_shared<BlockTimeSettingsModel>(startTime, endTime, week, isActive);
-    m_database->updateBlockTimeSettings(timeSettings);
-} 
\ No newline at end of file
+    return std::make_shared<BlockTimeSettingsModel>(startTime, endTime, week, isActive);
+} 
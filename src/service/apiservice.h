@@ -13,6 +13,8 @@ public:
     explicit ApiService(Database* database, QObject *parent = nullptr);
     ~ApiService();
 
+    // FOCCUSS_API_URL, then the sync/baseUrl setting, then the built-in server
+    static QString configuredBaseUrl(const Database* database);
     void setBaseUrl(const QString& url);
 
     void syncBlockedApps();
@@ -21,25 +23,158 @@ public:
     void syncTimeSettings();
     void fetchTimeSettings();
 
+    // Blocked apps and schedule in one round trip under one revision,
+    // applied in a single transaction
+    void fetchState();
+
+    // Queue an upload in the persistent outbox; bursts are debounced,
+    // failures retried with backoff and pending work resumed on restart
+    void scheduleBlockedAppsSync();
+    void scheduleTimeSettingsSync();
+
+    // Long-lived text/event-stream connection whose events trigger the
+    // matching fetch; reconnects on its own until stopped
+    void startPushChannel();
+    void stopPushChannel();
+    bool isPushConnected() const;
+
+    // The service and the window share one database, so only the process
+    // holding the sync lock talks to the server. The other one queues its
+    // work in the database and nudges the owner over a local socket, and
+    // takes over when the owner exits.
+    bool isSyncOwner() const;
+
+public slots:
+    void flushOutbox();
+
 signals:
     void syncCompleted(bool success);
     void syncFailed(const QString& error);
     void dataFetched(bool success);
 
 private slots:
-    void onBlockedAppsSyncFinished(QNetworkReply* reply);
+    void onBlockedAppsSyncFinished(QNetworkReply* reply, qint64 upToSeq);
+    void onBlockedAppOpsPushFinished(QNetworkReply* reply, qint64 upToSeq);
+    void onBlockedAppOpsPullFinished(QNetworkReply* reply);
     void onBlockedAppsFetchFinished(QNetworkReply* reply);
     void onTimeSettingsSyncFinished(QNetworkReply* reply);
     void onTimeSettingsFetchFinished(QNetworkReply* reply);
+    void onStateFetchFinished(QNetworkReply* reply);
+    void onReachabilityChanged(QNetworkInformation::Reachability reachability);
+    void connectPushChannel();
+    void onPushReadyRead();
+    void onPushFinished();
+    void onPushHeartbeatTimeout();
+    void pumpRequestQueue();
+    void claimSyncOwnership();
+    void onPeerConnected();
+    void onOwnerReadyRead();
 
 private:
     QNetworkAccessManager* m_networkManager;
     Database* m_database;
     QString m_baseUrl;
 
+    // Cleared when the server turns out not to know the op log endpoints
+    bool m_blockedAppOpsSupported;
+    bool m_blockedAppOpsPushInFlight;
+    bool m_blockedAppOpsPushQueued;
+
+    // Learned from server replies and remembered across runs
+    bool m_cborSupported;
+    bool m_deflateSupported;
+    // sync/h2c: the plain-http server speaks HTTP/2 without an upgrade
+    bool m_http2Direct;
+
+    // Resource -> queuedAt of the outbox entry being uploaded
+    QHash<QString, qint64> m_outboxInFlight;
+    QTimer m_outboxDebounceTimer;
+    QTimer m_outboxRetryTimer;
+    int m_outboxFailures;
+
+    QNetworkReply* m_pushReply;
+    QByteArray m_pushBuffer;
+    QByteArray m_pushEventName;
+    QByteArray m_pushEventData;
+    QByteArray m_pushLastEventId;
+    QTimer m_pushHeartbeatTimer;
+    QTimer m_pushReconnectTimer;
+    bool m_pushEnabled;
+    bool m_pushConnected;
+    int m_pushFailures;
+
+    struct PendingRequest
+    {
+        QByteArray verb;
+        QNetworkRequest request;
+        QByteArray body;
+        std::function<void(QNetworkReply*)> onFinished;
+        int attempt;
+    };
+
+    // Every request except the push stream goes through this queue; at most
+    // kMaxConcurrentRequests are in flight and none while the circuit is open
+    QList<PendingRequest> m_requestQueue;
+    int m_activeRequests;
+    int m_consecutiveFailures;
+    int m_circuitOpenings;
+    qint64 m_circuitOpenUntil;
+    QTimer m_circuitTimer;
+
+    QLockFile m_ownerLock;
+    bool m_isSyncOwner;
+    // Owner side: every other process connected to it
+    QLocalServer* m_ownerServer;
+    QList<QLocalSocket*> m_peers;
+    // Other side: connection to the owner
+    QLocalSocket* m_ownerSocket;
+    QTimer m_ownershipTimer;
+
+    int m_blockedAppsFetchGeneration;
+    int m_stateFetchGeneration;
+    // Cleared when the server has no combined state endpoint
+    bool m_stateSupported;
+
+    void sendRequest(const QByteArray& verb, const QNetworkRequest& request, const QByteArray& body,
+                     const std::function<void(QNetworkReply*)>& onFinished);
+    void startRequest(PendingRequest pending);
+    void onRequestFinished(QNetworkReply* reply, PendingRequest pending);
+    bool isTransientFailure(QNetworkReply* reply) const;
+    int retryDelay(QNetworkReply* reply, int attempt) const;
+    void openCircuit();
+
+    void syncBlockedAppsSnapshot();
+    void scheduleSync(const QString& resource);
+    void finishQueuedSync(const QString& resource, bool success);
+    void notifyOwner(const QByteArray& message);
+    void notifyPeers(const QByteArray& message);
+    void processPushLine(const QByteArray& line);
+    void dispatchPushEvent(const QByteArray& event, const QByteArray& data);
+
+    // Conditional GET carrying the stored ETag and revision of the resource
+    QNetworkRequest createFetchRequest(const QString& resource) const;
+    bool isNotModified(QNetworkReply* reply) const;
+
+    QByteArray encodeBody(const QJsonValue& body, QNetworkRequest& request) const;
+    QJsonValue decodeBody(QNetworkReply* reply);
+    static QJsonValue decodePayload(const QByteArray& data, bool isCbor, QString* error);
+    void learnServerCapabilities(QNetworkReply* reply);
+    bool isEncodingRejected(QNetworkReply* reply);
+    void storeValidators(const QString& resource, QNetworkReply* reply);
+    void storeValidators(const QString& resource, const QByteArray& etag, const QByteArray& revision);
+
     QJsonArray blockedAppsToJson() const;
+    QJsonArray blockedAppOpsToJson(const QList<BlockedAppOp>& ops) const;
+    BlockedAppOp blockedAppOpFromJson(const QJsonObject& opObj) const;
     QJsonObject timeSettingsToJson() const;
-    void processBlockedAppsResponse(const QJsonArray& apps);
+    // Runs on a pool thread: diff a full blocked-apps document against the rows
+    static QList<BlockedAppOp> diffBlockedApps(const QJsonArray& apps, const QHash<QString, BlockedAppOp>& current);
+    void applyFetchedBlockedApps(const QList<BlockedAppOp>& changes, bool ok, const QString& error,
+                                 const QByteArray& etag, const QByteArray& revision, int generation);
+    void applyFetchedState(const QList<BlockedAppOp>& changes, const QJsonObject& timeSettings,
+                           const QString& cursor, bool ok, const QString& error,
+                           const QByteArray& etag, const QByteArray& revision, int generation);
+    std::shared_ptr<BlockTimeSettingsModel> timeSettingsFromJson(const QJsonObject& settings) const;
     void processTimeSettingsResponse(const QJsonObject& settings);
 };
 
@@ -1,6 +1,12 @@
 #include "linuxservice.h"
 #include "../core/appmonitor.h"
+#include "../core/processterminator.h"
+#include "../core/cgroupfreezer.h"
+#include "../core/usagetracker.h"
+#include "../core/blockeventlog.h"
 #include "../data/database.h"
+#include "../ui/nativeoverlay.h"
+#include "apiservice.h"
 
 static QString s_logFilePath;
 
@@ -30,7 +36,13 @@ LinuxService::LinuxService(Database* database, QObject *parent)
       m_serviceDisplayName("Foccuss Service"),
       m_database(database),
       m_appMonitor(nullptr),
-      m_running(false)
+      m_nativeOverlay(nullptr),
+      m_terminator(nullptr),
+      m_freezer(nullptr),
+      m_apiService(nullptr),
+      m_usageTracker(nullptr),
+      m_eventLog(nullptr),
+      m_signalNotifier(nullptr)
 {
 }
 
@@ -61,6 +73,42 @@ bool LinuxService::initialize()
         return false;
     }
     
+    m_terminator = new ProcessTerminator(this);
+    m_freezer = new CgroupFreezer(this);
+    m_eventLog = new BlockEventLog(m_database, this);
+    
+    // No widgets in service mode, so blocks are shown through the xcb overlay
+    m_nativeOverlay = new NativeOverlay(this);
+    if (!m_nativeOverlay->isValid()) {
+        logToFileLS("Native overlay unavailable, blocks will not be displayed");
+    }
+    connect(m_nativeOverlay, &NativeOverlay::killRequested, m_terminator, &ProcessTerminator::terminate);
+    connect(m_nativeOverlay, &NativeOverlay::targetRemoved, m_freezer, &CgroupFreezer::thaw);
+    connect(m_appMonitor, &AppMonitor::blockedAppLaunched, this, &LinuxService::onBlockedAppLaunched);
+    connect(m_appMonitor, &AppMonitor::blockingPeriodEnded, m_freezer, &CgroupFreezer::thawAll);
+    
+    // The daemon outlives any UI session, so it follows policy changes itself.
+    // Only one of it and the window syncs at a time, see ApiService::isSyncOwner.
+    m_apiService = new ApiService(m_database, this);
+    m_apiService->setBaseUrl(ApiService::configuredBaseUrl(m_database));
+    m_apiService->fetchState();
+    m_apiService->startPushChannel();
+
+    // Only the daemon records usage; the window just reads the rollups
+    m_usageTracker = new UsageTracker(m_database, this);
+    m_usageTracker->startTracking();
+
+    // systemctl stop sends SIGTERM; quitting the event loop instead of dying
+    // thaws frozen apps, flushes the event log and releases the monitor
+    // lock, so the window takes over enforcement right away
+    if (!installSignalHandlers()) {
+        logToFileLS("Failed to install signal handlers, stopping will not clean up");
+    }
+
+    // The daemon enforces blocks whether or not the window is open
+    m_appMonitor->startMonitoring();
+    logToFileLS("AppMonitor started: " + QString(m_appMonitor->isMonitoring() ? "true" : "false"));
+    
     return true;
 }
 
@@ -98,6 +146,15 @@ bool LinuxService::uninstallService()
 
 bool LinuxService::startService()
 {
+    // The user manager is usually started before the X session, so the
+    // daemon would have no display to monitor or draw its overlay on
+    QProcess importProcess;
+    importProcess.start("systemctl", {"--user", "import-environment", "DISPLAY", "XAUTHORITY"});
+    importProcess.waitForFinished();
+    if (importProcess.exitCode() != 0) {
+        logToFileLS("Failed to pass the display to the service: " + importProcess.readAllStandardError());
+    }
+
     QProcess process;
     process.start("systemctl", {"--user", "start", m_serviceName});
     process.waitForFinished();
@@ -142,6 +199,31 @@ bool LinuxService::isServiceRunning() const
     return process.exitCode() == 0;
 }
 
+void LinuxService::onBlockedAppLaunched(Window targetWindow, const QString& appPath, const QString& appName,
+                                        const QList<ProcessRef>& processes, const QString& ruleKey)
+{
+    logToFileLS("Blocked application detected: " + appPath);
+    
+    // The mode is read on every detection so changes made in the UI apply immediately
+    const QString mode = m_database->getSetting("enforcement/mode", "overlay").toString();
+    if (mode == "terminate") {
+        m_terminator->terminate(processes);
+        m_eventLog->record(ruleKey, appPath, appName, mode, processes.size());
+        return;
+    }
+    
+    QString action = mode;
+    if (mode == "freeze" && !m_freezer->freeze(appPath, ProcessIdentity::livePids(processes))) {
+        logToFileLS("Could not freeze " + appPath + ", showing the overlay only");
+        action = "overlay";
+    }
+    m_eventLog->record(ruleKey, appPath, appName, action, processes.size());
+    
+    if (m_nativeOverlay && m_nativeOverlay->isValid()) {
+        m_nativeOverlay->showOverlay(targetWindow, appPath, appName, processes);
+    }
+}
+
 QString LinuxService::getServiceName() const
 {
     return m_serviceName;
@@ -173,7 +255,8 @@ bool LinuxService::createSystemdServiceFile()
     QTextStream out(&serviceFile);
     out << "[Unit]\n"
         << "Description=Foccuss Application Blocker Service\n"
-        << "After=network.target\n\n"
+        << "After=network.target graphical-session.target\n"
+        << "PartOf=graphical-session.target\n\n"
         << "[Service]\n"
         << "Type=simple\n"
         << "ExecStart=" << appPath << " --service\n"
@@ -231,23 +314,40 @@ bool LinuxService::disableService()
     return process.exitCode() == 0;
 }
 
-void LinuxService::serviceWorkerThread()
+// Written by the signal handler, read on the event loop; only write() is
+// async-signal-safe, so the handler does nothing else
+static int s_signalFds[2] = {-1, -1};
+
+static void handleTermSignal(int)
 {
-    if (!m_appMonitor)
-        return;
+    const char byte = 1;
+    ssize_t written = ::write(s_signalFds[0], &byte, sizeof(byte));
+    Q_UNUSED(written);
+}
 
-    // Start monitoring
-    logToFileLS("Starting AppMonitor...");
-    m_appMonitor->startMonitoring();
-    logToFileLS("AppMonitor started: " + QString(m_appMonitor->isMonitoring() ? "true" : "false"));
-    
-    // Main service loop
-    logToFileLS("Entering service main loop");
-    m_running = true;
-    
-    while (m_running) {
-        QThread::msleep(1000);
+bool LinuxService::installSignalHandlers()
+{
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, s_signalFds) != 0) {
+        return false;
     }
-    
-    logToFileLS("Service worker thread exiting");
-} 
\ No newline at end of file
+
+    m_signalNotifier = new QSocketNotifier(s_signalFds[1], QSocketNotifier::Read, this);
+    connect(m_signalNotifier, &QSocketNotifier::activated, this, &LinuxService::onTermSignal);
+
+    struct sigaction action = {};
+    action.sa_handler = handleTermSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+
+    return sigaction(SIGTERM, &action, nullptr) == 0 && sigaction(SIGINT, &action, nullptr) == 0;
+}
+
+void LinuxService::onTermSignal()
+{
+    char byte = 0;
+    ssize_t bytesRead = ::read(s_signalFds[1], &byte, sizeof(byte));
+    Q_UNUSED(bytesRead);
+
+    logToFileLS("Stop requested, shutting down");
+    QCoreApplication::quit();
+}
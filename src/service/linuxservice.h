@@ -3,9 +3,16 @@
 #define LINUXSERVICE_H
 
 #include "../../include/Common.h"
+#include "../core/processidentity.h"
 
 class AppMonitor;
 class Database;
+class NativeOverlay;
+class ProcessTerminator;
+class CgroupFreezer;
+class ApiService;
+class UsageTracker;
+class BlockEventLog;
 
 class LinuxService : public QObject
 {
@@ -26,12 +33,17 @@ public:
     QString getServiceName() const;
     QString getServiceDisplayName() const;
     
+private slots:
+    void onTermSignal();
+    void onBlockedAppLaunched(Window targetWindow, const QString& appPath, const QString& appName,
+                              const QList<ProcessRef>& processes, const QString& ruleKey);
+    
 private:
     bool createSystemdServiceFile();
     bool removeSystemdServiceFile();
     bool enableService();
     bool disableService();
-    void serviceWorkerThread();
+    bool installSignalHandlers();
     
     // Service name and status
     QString m_serviceName;
@@ -40,9 +52,13 @@ private:
     // Service components
     Database* m_database;
     AppMonitor* m_appMonitor;
-    
-    // Control event
-    bool m_running;
+    NativeOverlay* m_nativeOverlay;
+    ProcessTerminator* m_terminator;
+    CgroupFreezer* m_freezer;
+    ApiService* m_apiService;
+    UsageTracker* m_usageTracker;
+    BlockEventLog* m_eventLog;
+    QSocketNotifier* m_signalNotifier;
 };
 
 #endif // LINUXSERVICE_H 
\ No newline at end of file
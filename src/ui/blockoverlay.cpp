@@ -1,4 +1,5 @@
 #include "blockoverlay.h"
+#include "../core/x11connection.h"
 
 static QString s_logFilePath;
 
@@ -22,13 +23,11 @@ void logToFileBO(const QString& message)
     }
 }
 
-BlockOverlay::BlockOverlay(const X11Window targetWindow, const QString& appPath, const QString& appName, QWidget *parent)
+BlockOverlay::BlockOverlay(QWidget *parent)
     : QWidget(parent, Qt::Window | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::Tool),
-      m_targetWindow(targetWindow),
-      m_appPath(appPath),
-      m_appName(appName),
-      m_isClosing(false),
-      m_positionRetryCount(0)
+      m_targetWindow(None),
+      m_isWatching(false),
+      m_isPrimary(true)
 {
     setObjectName("blockOverlay");
     
@@ -36,7 +35,6 @@ BlockOverlay::BlockOverlay(const X11Window targetWindow, const QString& appPath,
     setAttribute(Qt::WA_NoSystemBackground, false);
     setAttribute(Qt::WA_ShowWithoutActivating, false);
     setAttribute(Qt::WA_AlwaysStackOnTop, true);
-    setAttribute(Qt::WA_DeleteOnClose, true);
     
     setWindowModality(Qt::ApplicationModal);
     
@@ -51,7 +49,6 @@ BlockOverlay::BlockOverlay(const X11Window targetWindow, const QString& appPath,
     mainLayout->addWidget(m_messageLabel);
     
     m_appNameLabel = new QLabel(this);
-    m_appNameLabel->setText(m_appName);
     m_appNameLabel->setAlignment(Qt::AlignCenter);
     mainLayout->addWidget(m_appNameLabel);
     
@@ -67,13 +64,94 @@ BlockOverlay::BlockOverlay(const X11Window targetWindow, const QString& appPath,
     buttonLayout->addWidget(m_closeButton);
     buttonLayout->addWidget(m_killButton);
     
-    m_checkTimer.setInterval(100);
-    connect(&m_checkTimer, &QTimer::timeout, this, &BlockOverlay::onCheckWindowPosition);
+    X11Connection *connection = X11Connection::instance();
+    connect(connection, &X11Connection::windowConfigured, this, &BlockOverlay::onTargetConfigured);
+    connect(connection, &X11Connection::windowMapped, this, &BlockOverlay::onTargetMapped);
+    connect(connection, &X11Connection::windowUnmapped, this, &BlockOverlay::onTargetUnmapped);
+    connect(connection, &X11Connection::windowDestroyed, this, &BlockOverlay::onTargetDestroyed);
 }
 
 BlockOverlay::~BlockOverlay()
 {
-    m_checkTimer.stop();
+    if (m_isWatching) {
+        X11Connection::instance()->unwatchWindow(m_targetWindow);
+    }
+}
+
+void BlockOverlay::prewarm()
+{
+    ensurePolished();
+    if (layout()) {
+        layout()->activate();
+    }
+
+    updateOverlayGeometry();
+    winId();
+}
+
+void BlockOverlay::bind(const X11Window targetWindow, const QString& appPath, const QString& appName, const QList<ProcessRef>& processes)
+{
+    unbind();
+
+    m_targetWindow = targetWindow;
+    m_appPath = appPath;
+    m_appName = appName;
+    m_processes = processes;
+    m_appNameLabel->setText(m_appName);
+
+    if (m_targetWindow != None) {
+        m_isWatching = true;
+        X11Connection::instance()->watchWindow(m_targetWindow);
+    }
+}
+
+void BlockOverlay::unbind()
+{
+    if (m_isWatching) {
+        m_isWatching = false;
+        X11Connection::instance()->unwatchWindow(m_targetWindow);
+    }
+
+    m_targetWindow = None;
+    m_appPath.clear();
+    m_appName.clear();
+    m_processes.clear();
+}
+
+X11Window BlockOverlay::targetWindow() const
+{
+    return m_targetWindow;
+}
+
+QString BlockOverlay::appPath() const
+{
+    return m_appPath;
+}
+
+QString BlockOverlay::appName() const
+{
+    return m_appName;
+}
+
+QList<ProcessRef> BlockOverlay::processes() const
+{
+    return m_processes;
+}
+
+void BlockOverlay::setProcesses(const QList<ProcessRef>& processes)
+{
+    m_processes = processes;
+}
+
+void BlockOverlay::setOutputGeometry(const QRect& geometry)
+{
+    m_outputGeometry = geometry;
+    updateOverlayGeometry();
+}
+
+void BlockOverlay::setPrimary(bool primary)
+{
+    m_isPrimary = primary;
 }
 
 void BlockOverlay::showOverlay()
@@ -82,9 +160,9 @@ void BlockOverlay::showOverlay()
     
     show();
     raise();
-    activateWindow();
-    
-    m_checkTimer.start();
+    if (m_isPrimary) {
+        activateWindow();
+    }
 }
 
 void BlockOverlay::paintEvent(QPaintEvent *event)
@@ -106,20 +184,30 @@ void BlockOverlay::paintEvent(QPaintEvent *event)
 
 void BlockOverlay::closeEvent(QCloseEvent *event)
 {
-    m_checkTimer.stop();
-    m_isClosing = true;
+    if (m_isWatching) {
+        m_isWatching = false;
+        X11Connection::instance()->unwatchWindow(m_targetWindow);
+    }
     event->accept();
+
+    emit finished();
 }
 
 void BlockOverlay::focusInEvent(QFocusEvent *event)
 {
     QWidget::focusInEvent(event);
-    raise();
-    activateWindow();
+    if (m_isPrimary) {
+        raise();
+        activateWindow();
+    }
 }
 
 bool BlockOverlay::event(QEvent *event)
 {
+    if (!m_isPrimary) {
+        return QWidget::event(event);
+    }
+
     if (event->type() == QEvent::WindowActivate) {
         raise();
         activateWindow();
@@ -140,107 +228,73 @@ void BlockOverlay::onCloseClicked()
 
 void BlockOverlay::onKillAppClicked()
 {
-    QFileInfo fileInfo(m_appPath);
-    QString processName = fileInfo.fileName();
-    
-    QProcess process;
-    process.start("pkill", QStringList() << "-9" << "-f" << processName);
-    process.waitForFinished();
+    emit killRequested(m_processes);
     
     close();
 }
 
-void BlockOverlay::onCheckWindowPosition()
+void BlockOverlay::onTargetConfigured(X11Window window, const QRect& geometry)
 {
-    if (m_targetWindow == None) {
+    Q_UNUSED(geometry);
+
+    if (window != m_targetWindow || !isVisible()) {
         return;
     }
 
-    updatePosition();
+    positionOverlayFullScreen();
 }
 
-void BlockOverlay::updatePosition()
+void BlockOverlay::onTargetMapped(X11Window window)
 {
-    if (m_targetWindow == None) {
+    if (window != m_targetWindow || !m_isWatching) {
         return;
     }
 
-    Display *display = XOpenDisplay(nullptr);
-    if (!display) {
-        logToFileBO("Failed to open X display");
-        return;
+    positionOverlayFullScreen();
+    show();
+    raise();
+    if (m_isPrimary) {
+        activateWindow();
     }
+}
 
-    XWindowAttributes attrs;
-    if (XGetWindowAttributes(display, m_targetWindow, &attrs)) {
-        if (attrs.map_state == IsViewable) {
-            if (attrs.width <= 0 || attrs.height <= 0) {
-                logToFileBO("Window has invalid dimensions, using fallback positioning");
-                positionOverlayFallback(display, attrs);
-                return;
-            }
-
-            positionOverlayFullScreen();
-            
-            if (m_checkTimer.interval() == 100) {
-                m_checkTimer.setInterval(500);
-            }
-            
-            m_positionRetryCount = 0;
-        }
-        else if (attrs.map_state == IsUnmapped) {
-            m_positionRetryCount++;
-            
-            if (m_positionRetryCount > 50) {
-                positionOverlayFallback(display, attrs);
-                m_checkTimer.setInterval(500);
-            }
-        }
-        else if (attrs.map_state == IsUnviewable) {
-            positionOverlayFallback(display, attrs);
-        }
-        else {
-            logToFileBO(QString("Unknown window state: %1").arg(attrs.map_state));
-            positionOverlayFallback(display, attrs);
-        }
-    } else {
-        logToFileBO("Failed to get window attributes for target window");
-        
-        Window root_return, parent_return;
-        Window* children_return;
-        unsigned int nchildren_return;
-        
-        if (XQueryTree(display, m_targetWindow, &root_return, &parent_return, &children_return, &nchildren_return) == 0) {
-            logToFileBO("Target window no longer exists, closing overlay");
-            close();
-            return;
-        }
-        
-        if (children_return) {
-            XFree(children_return);
-        }
-        
-        positionOverlayFallback(display);
+void BlockOverlay::onTargetUnmapped(X11Window window)
+{
+    if (window != m_targetWindow) {
+        return;
     }
 
-    XCloseDisplay(display);
-
-    if (m_isClosing)
-        close();
+    // Nothing left to cover until the target is mapped again
+    hide();
 }
 
-void BlockOverlay::positionOverlayFallback(Display *display, const XWindowAttributes &attrs)
+void BlockOverlay::onTargetDestroyed(X11Window window)
 {
-    positionOverlayFullScreen();
+    if (window != m_targetWindow) {
+        return;
+    }
+
+    logToFileBO("Target window no longer exists, closing overlay");
+    close();
 }
 
-void BlockOverlay::positionOverlayFallback(Display *display)
+void BlockOverlay::positionOverlayFullScreen()
 {
-    positionOverlayFullScreen();
+    updateOverlayGeometry();
+
+    raise();
+    if (m_isPrimary) {
+        activateWindow();
+    }
 }
 
-void BlockOverlay::positionOverlayFullScreen()
+void BlockOverlay::updateOverlayGeometry()
 {
+    if (m_outputGeometry.isValid()) {
+        setGeometry(m_outputGeometry);
+        return;
+    }
+
     QScreen *screen = QGuiApplication::primaryScreen();
     if (screen) {
         QRect virtualGeometry = screen->virtualGeometry();
@@ -253,11 +307,10 @@ void BlockOverlay::positionOverlayFullScreen()
             resize(screenGeometry.width(), screenGeometry.height());
         }
     } else {
-        move(0, 0);
-        resize(1920, 1080);
-        logToFileBO("Emergency full screen overlay at (0, 0) size: 1920x1080");
+        QList<QRect> outputs = X11Connection::instance()->outputGeometries();
+        QRect fallback = outputs.isEmpty() ? QRect(0, 0, 1920, 1080) : outputs.first();
+        setGeometry(fallback);
+        logToFileBO(QString("Emergency overlay at (%1, %2) size: %3x%4")
+                    .arg(fallback.x()).arg(fallback.y()).arg(fallback.width()).arg(fallback.height()));
     }
-    
-    raise();
-    activateWindow();
 }
@@ -2,17 +2,37 @@
 #define BLOCKOVERLAY_H
 
 #include "../../include/Common.h"
+#include "../core/processidentity.h"
 
 class BlockOverlay : public QWidget
 {
     Q_OBJECT
     
 public:
-    explicit BlockOverlay(const X11Window targetWindow, const QString& appPath, const QString& appName, QWidget *parent = nullptr);
+    explicit BlockOverlay(QWidget *parent = nullptr);
     ~BlockOverlay();
     
+    // Polish, lay out and create the native window ahead of time
+    void prewarm();
+    void bind(const X11Window targetWindow, const QString& appPath, const QString& appName, const QList<ProcessRef>& processes);
+    void unbind();
+    X11Window targetWindow() const;
+    QString appPath() const;
+    QString appName() const;
+    QList<ProcessRef> processes() const;
+    void setProcesses(const QList<ProcessRef>& processes);
+
+    // Output this overlay covers, in logical coordinates
+    void setOutputGeometry(const QRect& geometry);
+    // Only the primary overlay of a group grabs activation
+    void setPrimary(bool primary);
+
     void showOverlay();
     
+signals:
+    void finished();
+    void killRequested(const QList<ProcessRef>& processes);
+    
 protected:
     void paintEvent(QPaintEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
@@ -22,26 +42,28 @@ protected:
 private slots:
     void onCloseClicked();
     void onKillAppClicked();
-    void onCheckWindowPosition();
+    void onTargetConfigured(X11Window window, const QRect& geometry);
+    void onTargetMapped(X11Window window);
+    void onTargetUnmapped(X11Window window);
+    void onTargetDestroyed(X11Window window);
     
 private:
-    void updatePosition();
-    void positionOverlayFallback(Display *display, const XWindowAttributes &attrs);
-    void positionOverlayFallback(Display *display);
     void positionOverlayFullScreen();
+    void updateOverlayGeometry();
 
 private:
     QString m_appPath;
     QString m_appName;
+    QList<ProcessRef> m_processes;
     QLabel *m_messageLabel;
     QLabel *m_appNameLabel;
     QPushButton *m_closeButton;
     QPushButton *m_killButton;
     
     X11Window m_targetWindow;
-    QTimer m_checkTimer;
-    bool m_isClosing;
-    int m_positionRetryCount;
+    bool m_isWatching;
+    bool m_isPrimary;
+    QRect m_outputGeometry;
 };
 
 #endif // BLOCKOVERLAY_H 
\ No newline at end of file
@@ -1,8 +1,14 @@
 #include "mainwindow.h"
 #include "blockoverlay.h"
+#include "overlaypool.h"
+#include "nativeoverlay.h"
 #include "applistmodel.h"
 #include "../core/appdetector.h"
 #include "../core/appmonitor.h"
+#include "../core/processterminator.h"
+#include "../core/cgroupfreezer.h"
+#include "../core/blockeventlog.h"
+#include "../core/contenthasher.h"
 #include "../data/database.h"
 #include "../data/appmodel.h"
 #include "../data/blockTimeSettingsModel.h"
@@ -48,12 +54,26 @@ MainWindow::MainWindow(Database* database, QWidget *parent)
       m_appMonitor(nullptr),
       m_database(database),
       m_service(nullptr),
-      m_apiService(nullptr)
+      m_apiService(nullptr),
+      m_overlayPool(nullptr),
+      m_nativeOverlay(nullptr),
+      m_terminator(nullptr),
+      m_freezer(nullptr),
+      m_eventLog(nullptr)
 {
     m_appDetector = new AppDetector(this);
     
+    m_terminator = new ProcessTerminator(this);
+    m_freezer = new CgroupFreezer(this);
+    m_eventLog = new BlockEventLog(m_database, this);
+
+    m_overlayPool = new OverlayPool(2, this);
+    connect(m_overlayPool, &OverlayPool::killRequested, m_terminator, &ProcessTerminator::terminate);
+    connect(m_overlayPool, &OverlayPool::overlayDismissed, m_freezer, &CgroupFreezer::thaw);
+
     m_appMonitor = new AppMonitor(m_database, this);
     connect(m_appMonitor, &AppMonitor::blockedAppLaunched, this, &MainWindow::onBlockedAppLaunched);
+    connect(m_appMonitor, &AppMonitor::blockingPeriodEnded, m_freezer, &CgroupFreezer::thawAll);
     
     m_filteredInstalledApps.clear();
     m_filteredBlockedApps.clear();
@@ -115,14 +135,29 @@ void MainWindow::setupUi()
     // Create tabs
     m_appsTab = new QWidget();
     m_settingsTab = new QWidget();
+    m_statisticsTab = new QWidget();
+    m_historyTab = new QWidget();
     
     // Setup each tab
     setupAppsTab();
     setupSettingsTab();
+    setupStatisticsTab();
+    setupHistoryTab();
     
     // Add tabs to tab widget
     m_tabWidget->addTab(m_appsTab, "Applications");
     m_tabWidget->addTab(m_settingsTab, "Settings");
+    m_tabWidget->addTab(m_statisticsTab, "Statistics");
+    m_tabWidget->addTab(m_historyTab, "History");
+
+    // Usage and block events are recorded by the service, so re-read them whenever a tab is shown
+    connect(m_tabWidget, &QTabWidget::currentChanged, this, [this](int index) {
+        if (m_tabWidget->widget(index) == m_statisticsTab) {
+            loadUsageStatistics();
+        } else if (m_tabWidget->widget(index) == m_historyTab) {
+            reloadBlockHistory();
+        }
+    });
     
     mainLayout->addWidget(m_tabWidget);
     
@@ -215,7 +250,12 @@ void MainWindow::setupAppsTab()
                 m_blockButton->setEnabled(m_selectedInstalledApp != nullptr);
             });
     
+    m_blockCopiesCheckBox = new QCheckBox("Also block copies", this);
+    m_blockCopiesCheckBox->setToolTip("Match the executable by its contents, so renamed or copied binaries are blocked too");
+    m_blockCopiesCheckBox->setVisible(ContentHasher::isAvailable());
+    
     QHBoxLayout *installedButtonsLayout = new QHBoxLayout();
+    installedButtonsLayout->addWidget(m_blockCopiesCheckBox);
     installedButtonsLayout->addWidget(m_refreshButton);
     installedButtonsLayout->addWidget(m_blockButton);
     
@@ -359,21 +399,262 @@ void MainWindow::setupSettingsTab()
     timeLayout->addLayout(saveLayout);
     
     tabLayout->addWidget(timeGroup);
+    
+    // Enforcement Group
+    QGroupBox *enforcementGroup = new QGroupBox("Enforcement", this);
+    QVBoxLayout *enforcementLayout = new QVBoxLayout(enforcementGroup);
+    
+    m_nativeOverlayCheckBox = new QCheckBox("Use lightweight native overlay", this);
+    m_nativeOverlayCheckBox->setToolTip("Draw the block screen directly with X11 instead of a Qt window");
+    m_nativeOverlayCheckBox->setChecked(m_database->getSetting("overlay/backend").toString() == "native");
+    connect(m_nativeOverlayCheckBox, &QCheckBox::toggled, this, &MainWindow::onNativeOverlayToggled);
+    enforcementLayout->addWidget(m_nativeOverlayCheckBox);
+    
+    QHBoxLayout *modeLayout = new QHBoxLayout();
+    QLabel *modeLabel = new QLabel("When a blocked app is detected:", this);
+    m_enforcementModeCombo = new QComboBox(this);
+    m_enforcementModeCombo->addItem("Show block overlay", "overlay");
+    m_enforcementModeCombo->addItem("Terminate the app", "terminate");
+    m_enforcementModeCombo->addItem("Freeze the app", "freeze");
+    m_enforcementModeCombo->setItemData(2, "Suspend the app until the block is dismissed or the schedule ends",
+                                        Qt::ToolTipRole);
+    int modeIndex = m_enforcementModeCombo->findData(m_database->getSetting("enforcement/mode", "overlay").toString());
+    m_enforcementModeCombo->setCurrentIndex(modeIndex >= 0 ? modeIndex : 0);
+    connect(m_enforcementModeCombo, &QComboBox::currentIndexChanged, this, &MainWindow::onEnforcementModeChanged);
+    modeLayout->addWidget(modeLabel);
+    modeLayout->addWidget(m_enforcementModeCombo);
+    modeLayout->addStretch();
+    enforcementLayout->addLayout(modeLayout);
+    
+    tabLayout->addWidget(enforcementGroup);
+    
+    // Pattern Rules Group
+    QGroupBox *patternGroup = new QGroupBox("Pattern Rules", this);
+    QVBoxLayout *patternLayout = new QVBoxLayout(patternGroup);
+    
+    m_patternRulesList = new QListWidget(this);
+    m_patternRulesList->setMaximumHeight(120);
+    
+    QHBoxLayout *patternEditLayout = new QHBoxLayout();
+    m_patternKindCombo = new QComboBox(this);
+    m_patternKindCombo->addItem("Window title contains", "title");
+    m_patternKindCombo->addItem("Command line contains", "cmdline");
+    m_patternKindCombo->addItem("Path matches glob", "glob");
+    m_patternKindCombo->addItem("Path matches regex", "regex");
+    m_patternKindCombo->setItemData(1, "Arguments separated by spaces must be consecutive, e.g. \"python -m http.server\"",
+                                    Qt::ToolTipRole);
+    m_patternKindCombo->setItemData(2, "* and ** match any characters, e.g. /opt/games/** or */steam*", Qt::ToolTipRole);
+    m_patternRuleEdit = new QLineEdit(this);
+    m_patternRuleEdit->setPlaceholderText("Text to match...");
+    QPushButton *addPatternButton = new QPushButton("Add", this);
+    QPushButton *removePatternButton = new QPushButton("Remove", this);
+    connect(addPatternButton, &QPushButton::clicked, this, &MainWindow::onAddPatternRule);
+    connect(m_patternRuleEdit, &QLineEdit::returnPressed, this, &MainWindow::onAddPatternRule);
+    connect(removePatternButton, &QPushButton::clicked, this, &MainWindow::onRemovePatternRule);
+    patternEditLayout->addWidget(m_patternKindCombo);
+    patternEditLayout->addWidget(m_patternRuleEdit);
+    patternEditLayout->addWidget(addPatternButton);
+    patternEditLayout->addWidget(removePatternButton);
+    
+    patternLayout->addWidget(m_patternRulesList);
+    patternLayout->addLayout(patternEditLayout);
+    
+    tabLayout->addWidget(patternGroup);
     tabLayout->addStretch();
+    
+    loadPatternRules();
+    
+    if (m_nativeOverlayCheckBox->isChecked()) {
+        createNativeOverlay();
+    }
+}
+
+void MainWindow::loadPatternRules()
+{
+    m_patternRulesList->clear();
+    
+    for (int i = 0; i < m_patternKindCombo->count(); ++i) {
+        const QString kind = m_patternKindCombo->itemData(i).toString();
+        const QString label = m_patternKindCombo->itemText(i);
+        for (const QString& pattern : m_database->getBlockRules(kind)) {
+            QListWidgetItem *item = new QListWidgetItem(label + ": " + pattern, m_patternRulesList);
+            item->setData(Qt::UserRole, kind);
+            item->setData(Qt::UserRole + 1, pattern);
+        }
+    }
+}
+
+void MainWindow::onAddPatternRule()
+{
+    QString pattern = m_patternRuleEdit->text().trimmed();
+    if (pattern.isEmpty())
+        return;
+    
+    const QString kind = m_patternKindCombo->currentData().toString();
+    if (kind == "regex" && !QRegularExpression(pattern).isValid()) {
+        statusBar()->showMessage("Invalid regular expression: " + QRegularExpression(pattern).errorString(), 5000);
+        return;
+    }
+    
+    if (m_database->addBlockRule(kind, pattern)) {
+        m_patternRuleEdit->clear();
+        loadPatternRules();
+    }
+}
+
+void MainWindow::onRemovePatternRule()
+{
+    QListWidgetItem *item = m_patternRulesList->currentItem();
+    if (!item)
+        return;
+    
+    if (m_database->removeBlockRule(item->data(Qt::UserRole).toString(), item->data(Qt::UserRole + 1).toString())) {
+        loadPatternRules();
+    }
+}
+
+void MainWindow::setupStatisticsTab()
+{
+    QVBoxLayout *tabLayout = new QVBoxLayout(m_statisticsTab);
+    
+    QHBoxLayout *rangeLayout = new QHBoxLayout();
+    QLabel *rangeLabel = new QLabel("Foreground time:", this);
+    m_usageRangeCombo = new QComboBox(this);
+    m_usageRangeCombo->addItem("Today", 1);
+    m_usageRangeCombo->addItem("Last 7 days", 7);
+    m_usageRangeCombo->addItem("Last 30 days", 30);
+    connect(m_usageRangeCombo, &QComboBox::currentIndexChanged, this, &MainWindow::loadUsageStatistics);
+    
+    QPushButton *refreshUsageButton = new QPushButton("Refresh", this);
+    connect(refreshUsageButton, &QPushButton::clicked, this, &MainWindow::loadUsageStatistics);
+    
+    rangeLayout->addWidget(rangeLabel);
+    rangeLayout->addWidget(m_usageRangeCombo);
+    rangeLayout->addStretch();
+    rangeLayout->addWidget(refreshUsageButton);
+    
+    m_usageTable = new QTableWidget(0, 2, this);
+    m_usageTable->setHorizontalHeaderLabels({"Application", "Time"});
+    m_usageTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_usageTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    m_usageTable->verticalHeader()->setVisible(false);
+    m_usageTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_usageTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    
+    // Only the service records usage, so without it the table stays empty
+    m_usageServiceNote = new QLabel("Foreground time is recorded by the Foccuss service, "
+                                    "which is not running. Start it from the Settings tab.", this);
+    m_usageServiceNote->setWordWrap(true);
+    m_usageServiceNote->setVisible(false);
+    
+    tabLayout->addLayout(rangeLayout);
+    tabLayout->addWidget(m_usageServiceNote);
+    tabLayout->addWidget(m_usageTable);
+}
+
+void MainWindow::loadUsageStatistics()
+{
+    int days = m_usageRangeCombo->currentData().toInt();
+    QDate firstDay = QDate::currentDate().addDays(1 - days);
+    qint64 from = firstDay.startOfDay().toSecsSinceEpoch();
+    qint64 to = QDate::currentDate().addDays(1).startOfDay().toSecsSinceEpoch();
+    
+    m_usageServiceNote->setVisible(!m_service || !m_service->isServiceRunning());
+    
+    // Whole days come straight from the day rollup
+    QList<QPair<QString, qint64>> totals = m_database->getUsageTotals(UsageResolution::Day, from, to);
+    
+    m_usageTable->setRowCount(totals.size());
+    for (int row = 0; row < totals.size(); ++row) {
+        const QString& appPath = totals[row].first;
+        qint64 minutes = totals[row].second / 60000;
+        
+        QTableWidgetItem *appItem = new QTableWidgetItem(QFileInfo(appPath).fileName());
+        appItem->setToolTip(appPath);
+        QTableWidgetItem *timeItem = new QTableWidgetItem(
+            QString("%1h %2m").arg(minutes / 60).arg(minutes % 60, 2, 10, QChar('0')));
+        timeItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        
+        m_usageTable->setItem(row, 0, appItem);
+        m_usageTable->setItem(row, 1, timeItem);
+    }
+}
+
+void MainWindow::setupHistoryTab()
+{
+    QVBoxLayout *tabLayout = new QVBoxLayout(m_historyTab);
+    
+    m_historyTable = new QTableWidget(0, 4, this);
+    m_historyTable->setHorizontalHeaderLabels({"Time", "Application", "Action", "Total blocks"});
+    m_historyTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_historyTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    m_historyTable->verticalHeader()->setVisible(false);
+    m_historyTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_historyTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    QPushButton *refreshHistoryButton = new QPushButton("Refresh", this);
+    m_historyMoreButton = new QPushButton("Load older", this);
+    connect(refreshHistoryButton, &QPushButton::clicked, this, &MainWindow::reloadBlockHistory);
+    connect(m_historyMoreButton, &QPushButton::clicked, this, &MainWindow::loadMoreBlockHistory);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(refreshHistoryButton);
+    buttonsLayout->addWidget(m_historyMoreButton);
+    
+    tabLayout->addWidget(m_historyTable);
+    tabLayout->addLayout(buttonsLayout);
+    
+    m_historyOldestId = 0;
+}
+
+void MainWindow::reloadBlockHistory()
+{
+    m_historyTable->setRowCount(0);
+    m_historyOldestId = 0;
+    loadMoreBlockHistory();
+}
+
+void MainWindow::loadMoreBlockHistory()
+{
+    static const int kHistoryPageSize = 100;
+    
+    QList<BlockEvent> events = m_database->getBlockEvents(m_historyOldestId, kHistoryPageSize);
+    QHash<QString, qint64> hitCounts = m_database->getBlockHitCounts();
+    
+    int row = m_historyTable->rowCount();
+    m_historyTable->setRowCount(row + events.size());
+    for (const BlockEvent& event : events) {
+        QTableWidgetItem *appItem = new QTableWidgetItem(event.appName);
+        appItem->setToolTip(event.appPath);
+        QTableWidgetItem *countItem = new QTableWidgetItem(QString::number(
+            hitCounts.value(event.ruleKey.isEmpty() ? event.appPath : event.ruleKey)));
+        countItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        
+        m_historyTable->setItem(row, 0, new QTableWidgetItem(
+            QDateTime::fromMSecsSinceEpoch(event.occurredAt).toString("yyyy-MM-dd hh:mm:ss")));
+        m_historyTable->setItem(row, 1, appItem);
+        m_historyTable->setItem(row, 2, new QTableWidgetItem(event.action));
+        m_historyTable->setItem(row, 3, countItem);
+        ++row;
+        
+        m_historyOldestId = event.id;
+    }
+    
+    m_historyMoreButton->setEnabled(events.size() == kHistoryPageSize);
 }
 
 void MainWindow::setupApiService()
 {
     m_apiService = new ApiService(m_database, this);
 
-    m_apiService->setBaseUrl("http://ec2-18-219-89-146.us-east-2.compute.amazonaws.com:3000");
+    m_apiService->setBaseUrl(ApiService::configuredBaseUrl(m_database));
 
     connect(m_apiService, &ApiService::syncCompleted, this, &MainWindow::onSyncCompleted);
     connect(m_apiService, &ApiService::syncFailed, this, &MainWindow::onSyncFailed);
     connect(m_apiService, &ApiService::dataFetched, this, &MainWindow::onDataFetched);
 
-    m_apiService->fetchBlockedApps();
-    m_apiService->fetchTimeSettings();
+    m_apiService->fetchState();
+    m_apiService->startPushChannel();
 }
 
 void MainWindow::loadBlockedApps()
@@ -439,8 +720,11 @@ void MainWindow::onBlockApp()
     if (m_selectedInstalledApp && m_selectedInstalledApp->isValid()) {
         if (m_database->addBlockedApp(m_selectedInstalledApp->getPath(), 
                                      m_selectedInstalledApp->getName())) {
+            if (m_blockCopiesCheckBox->isChecked()) {
+                addContentRule(m_selectedInstalledApp->getPath(), m_selectedInstalledApp->getName());
+            }
             loadBlockedApps();
-            m_apiService->syncBlockedApps();
+            m_apiService->scheduleBlockedAppsSync();
             
             QMessageBox::information(this, "Success", 
                                    "Application has been blocked: " + 
@@ -453,12 +737,31 @@ void MainWindow::onBlockApp()
     }
 }
 
+void MainWindow::addContentRule(const QString& appPath, const QString& appName)
+{
+    // Desktop entries may name the program without a directory
+    QString executable = QFileInfo(appPath).isAbsolute() ? appPath : QStandardPaths::findExecutable(appPath);
+    QByteArray encodedPath = QFile::encodeName(executable);
+    
+    ContentHasher hasher;
+    ContentHasher::FileKey fileKey;
+    quint64 digest = 0;
+    if (executable.isEmpty()
+        || !ContentHasher::fileKey(encodedPath.constData(), &fileKey)
+        || !hasher.hash(encodedPath.constData(), fileKey, &digest)) {
+        statusBar()->showMessage("Could not read " + appName + " to block its copies", 5000);
+        return;
+    }
+    
+    m_database->addBlockedApp(ContentHasher::toRulePath(fileKey.size, digest), appName + " (copies)");
+}
+
 void MainWindow::onUnblockApp()
 {
     if (m_selectedBlockedApp && m_selectedBlockedApp->isValid()) {
         if (m_database->removeBlockedApp(m_selectedBlockedApp->getPath())) {
             loadBlockedApps();
-            m_apiService->syncBlockedApps();
+            m_apiService->scheduleBlockedAppsSync();
             
             QMessageBox::information(this, "Success", 
                                    "Application has been unblocked: " + 
@@ -504,12 +807,29 @@ void MainWindow::onAppSelected(const QModelIndex &index)
     }
 }
 
-void MainWindow::onBlockedAppLaunched(Window targetWindow, const QString& appPath, const QString& appName)
+void MainWindow::onBlockedAppLaunched(Window targetWindow, const QString& appPath, const QString& appName,
+                                      const QList<ProcessRef>& processes, const QString& ruleKey)
 {
-    BlockOverlay *overlay = new BlockOverlay(targetWindow, appPath, appName);
-    
-    overlay->setAttribute(Qt::WA_DeleteOnClose);
-    overlay->showOverlay();
+    const QString mode = m_enforcementModeCombo->currentData().toString();
+    if (mode == "terminate") {
+        m_terminator->terminate(processes);
+        m_eventLog->record(ruleKey, appPath, appName, mode, processes.size());
+        return;
+    }
+
+    // A frozen app stays on screen, so the overlay is still shown on top of it
+    QString action = mode;
+    if (mode == "freeze" && !m_freezer->freeze(appPath, ProcessIdentity::livePids(processes))) {
+        logToFileMW("Could not freeze " + appPath + ", showing the overlay only");
+        action = "overlay";
+    }
+    m_eventLog->record(ruleKey, appPath, appName, action, processes.size());
+
+    if (m_nativeOverlay && m_nativeOverlay->isValid()) {
+        m_nativeOverlay->showOverlay(targetWindow, appPath, appName, processes);
+    } else {
+        m_overlayPool->showOverlay(targetWindow, appPath, appName, processes);
+    }
 }
 
 void MainWindow::onTrayIconActivated(QSystemTrayIcon::ActivationReason reason)
@@ -655,7 +975,7 @@ void MainWindow::onSaveTimeSettings()
     
     // Save to database
     if (m_database->updateBlockTimeSettings(m_timeSettings)) {
-        m_apiService->syncTimeSettings();
+        m_apiService->scheduleTimeSettingsSync();
         QMessageBox::information(this, "Success", "Time settings saved successfully");
     } else {
         QMessageBox::warning(this, "Error", "Failed to save time settings");
@@ -672,7 +992,8 @@ void MainWindow::onSyncCompleted(bool success)
 void MainWindow::onSyncFailed(const QString& error)
 {
     qDebug() << "Sync failed:" << error;
-    QMessageBox::warning(this, "Sync Error", "Failed to sync with server: " + error);
+    // Queued changes are retried by the outbox, so there is nothing to confirm
+    statusBar()->showMessage("Sync failed, pending changes will be retried: " + error, 10000);
 }
 
 void MainWindow::onDataFetched(bool success)
@@ -683,6 +1004,35 @@ void MainWindow::onDataFetched(bool success)
     }
 }
 
+void MainWindow::onNativeOverlayToggled(bool checked)
+{
+    m_database->setSetting("overlay/backend", checked ? "native" : "widget");
+    
+    if (checked && !m_nativeOverlay) {
+        createNativeOverlay();
+        if (!m_nativeOverlay->isValid()) {
+            QMessageBox::warning(this, "Error",
+                               "The native overlay is not available, falling back to the default overlay");
+        }
+    } else if (!checked && m_nativeOverlay) {
+        m_nativeOverlay->hideOverlay();
+        m_nativeOverlay->deleteLater();
+        m_nativeOverlay = nullptr;
+    }
+}
+
+void MainWindow::onEnforcementModeChanged(int index)
+{
+    m_database->setSetting("enforcement/mode", m_enforcementModeCombo->itemData(index).toString());
+}
+
+void MainWindow::createNativeOverlay()
+{
+    m_nativeOverlay = new NativeOverlay(this);
+    connect(m_nativeOverlay, &NativeOverlay::killRequested, m_terminator, &ProcessTerminator::terminate);
+    connect(m_nativeOverlay, &NativeOverlay::targetRemoved, m_freezer, &CgroupFreezer::thaw);
+}
+
 void MainWindow::filterAppList(const QString& searchText, bool isInstalledList)
 {
     QList<std::shared_ptr<AppModel>>& sourceList = isInstalledList ? m_installedApps : m_blockedApps;
@@ -5,6 +5,7 @@
 #include "../../include/Common.h"
 #include "../../include/ForwardDeclarations.h"
 #include "../service/apiservice.h"
+#include "../core/processidentity.h"
 
 class MainWindow : public QMainWindow
 {
@@ -22,7 +23,8 @@ private slots:
     void onBlockApp();
     void onUnblockApp();
     void onAppSelected(const QModelIndex &index);
-    void onBlockedAppLaunched(Window targetWindow, const QString& appPath, const QString& appName);
+    void onBlockedAppLaunched(Window targetWindow, const QString& appPath, const QString& appName,
+                              const QList<ProcessRef>& processes, const QString& ruleKey);
     void onTrayIconActivated(QSystemTrayIcon::ActivationReason reason);
     void onServiceStatusToggled(bool checked);
     void onInstallService();
@@ -35,12 +37,21 @@ private slots:
     void onSyncCompleted(bool success);
     void onSyncFailed(const QString& error);
     void onDataFetched(bool success);
+    void onNativeOverlayToggled(bool checked);
+    void onEnforcementModeChanged(int index);
+    void loadUsageStatistics();
+    void onAddPatternRule();
+    void onRemovePatternRule();
+    void reloadBlockHistory();
+    void loadMoreBlockHistory();
 
 private:
     void setupUi();
     void setupTrayIcon();
     void setupAppsTab();
     void setupSettingsTab();
+    void setupStatisticsTab();
+    void setupHistoryTab();
     void loadBlockedApps();
     void updateServiceStatus();
     void updateServiceButtons();
@@ -48,11 +59,16 @@ private:
     void loadTimeSettings();
     void saveTimeSettings();
     void setupApiService();
+    void createNativeOverlay();
+    void addContentRule(const QString& appPath, const QString& appName);
+    void loadPatternRules();
     
 private:
     QTabWidget* m_tabWidget;
     QWidget* m_appsTab;
     QWidget* m_settingsTab;
+    QWidget* m_statisticsTab;
+    QWidget* m_historyTab;
     
     QListView *m_installedAppsView;
     QListView *m_blockedAppsView;
@@ -61,6 +77,7 @@ private:
     QPushButton *m_refreshButton;
     QPushButton *m_blockButton;
     QPushButton *m_unblockButton;
+    QCheckBox *m_blockCopiesCheckBox;
     QPushButton *m_installServiceButton;
     QPushButton *m_uninstallServiceButton;
     QPushButton *m_startServiceButton;
@@ -79,6 +96,20 @@ private:
     QCheckBox* m_sundayCheckBox;
     QCheckBox* m_blockingActiveCheckBox;
     QPushButton* m_saveSettingsButton;
+    QCheckBox* m_nativeOverlayCheckBox;
+    QComboBox* m_enforcementModeCombo;
+    QListWidget* m_patternRulesList;
+    QComboBox* m_patternKindCombo;
+    QLineEdit* m_patternRuleEdit;
+
+    QComboBox* m_usageRangeCombo;
+    QTableWidget* m_usageTable;
+    QLabel* m_usageServiceNote;
+
+    QTableWidget* m_historyTable;
+    QPushButton* m_historyMoreButton;
+    // Keyset cursor: id of the oldest event shown so far
+    qint64 m_historyOldestId;
 
     QSystemTrayIcon *m_trayIcon;
     QMenu *m_trayMenu;
@@ -93,6 +124,11 @@ private:
     Database *m_database;
     LinuxService *m_service;
     ApiService *m_apiService;
+    OverlayPool *m_overlayPool;
+    NativeOverlay *m_nativeOverlay;
+    ProcessTerminator *m_terminator;
+    CgroupFreezer *m_freezer;
+    BlockEventLog *m_eventLog;
 
     std::shared_ptr<AppModel> m_selectedInstalledApp;
     std::shared_ptr<AppModel> m_selectedBlockedApp;
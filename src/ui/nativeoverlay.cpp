@@ -0,0 +1,608 @@
+#include "nativeoverlay.h"
+#include "../core/x11connection.h"
+
+static QString s_logFilePath;
+
+void logToFileNO(const QString& message)
+{
+    if (s_logFilePath.isEmpty()) {
+        QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir appDataDir(appDataPath);
+        if (!appDataDir.exists()) {
+            appDataDir.mkpath(".");
+        }
+        s_logFilePath = appDataDir.filePath("foccuss_service.log");
+    }
+
+    QFile logFile(s_logFilePath);
+    if (logFile.open(QIODevice::Append | QIODevice::Text)) {
+        QTextStream out(&logFile);
+        out << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
+            << " - " << message << "\n";
+        logFile.close();
+    }
+}
+
+namespace {
+    const int kBorderWidth = 5;
+    const uint32_t kBorderPixel = 0xFFFF0000;
+    // Premultiplied black at the same alpha the widget overlay ends up with
+    const uint32_t kBackgroundPixel = 0xA0000000;
+}
+
+NativeOverlay::NativeOverlay(QObject *parent)
+    : QObject(parent),
+      m_connection(nullptr),
+      m_screen(nullptr),
+      m_visual(0),
+      m_depth(0),
+      m_colormap(0),
+      m_contentPixmap(0),
+      m_gc(0),
+      m_notifier(nullptr),
+      m_contentSize(520, 200),
+      m_closeButtonRect(40, 130, 200, 44),
+      m_killButtonRect(280, 130, 200, 44),
+      m_isMapped(false)
+{
+    int screenNumber = 0;
+    m_connection = xcb_connect(nullptr, &screenNumber);
+    if (xcb_connection_has_error(m_connection)) {
+        logToFileNO("Failed to connect to the X server for the native overlay");
+        xcb_disconnect(m_connection);
+        m_connection = nullptr;
+        return;
+    }
+
+    xcb_screen_iterator_t screenIt = xcb_setup_roots_iterator(xcb_get_setup(m_connection));
+    for (int i = 0; i < screenNumber && screenIt.rem; ++i) {
+        xcb_screen_next(&screenIt);
+    }
+    m_screen = screenIt.data;
+
+    if (!m_screen || !createResources()) {
+        logToFileNO("Failed to create the native overlay resources");
+        destroyResources();
+        xcb_disconnect(m_connection);
+        m_connection = nullptr;
+        return;
+    }
+
+    createOutputWindows();
+
+    m_notifier = new QSocketNotifier(xcb_get_file_descriptor(m_connection), QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &NativeOverlay::processEvents);
+
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    if (dispatcher) {
+        connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this, &NativeOverlay::onAboutToBlock);
+    }
+
+    X11Connection *connection = X11Connection::instance();
+    connect(connection, &X11Connection::windowConfigured, this, &NativeOverlay::onTargetConfigured);
+    connect(connection, &X11Connection::windowMapped, this, &NativeOverlay::onTargetMapped);
+    connect(connection, &X11Connection::windowUnmapped, this, &NativeOverlay::onTargetUnmapped);
+    connect(connection, &X11Connection::windowDestroyed, this, &NativeOverlay::onTargetDestroyed);
+    connect(connection, &X11Connection::screenLayoutChanged, this, &NativeOverlay::onScreenLayoutChanged);
+}
+
+NativeOverlay::~NativeOverlay()
+{
+    for (const Target& target : std::as_const(m_targets)) {
+        X11Connection::instance()->unwatchWindow(target.window);
+    }
+    m_targets.clear();
+
+    if (m_connection) {
+        destroyOutputWindows();
+        destroyResources();
+        xcb_disconnect(m_connection);
+        m_connection = nullptr;
+    }
+}
+
+bool NativeOverlay::isValid() const
+{
+    return m_connection != nullptr && !m_outputWindows.isEmpty();
+}
+
+bool NativeOverlay::createResources()
+{
+    // Prefer a 32-bit TrueColor visual so a compositor can blend the overlay
+    m_visual = m_screen->root_visual;
+    m_depth = m_screen->root_depth;
+
+    xcb_depth_iterator_t depthIt = xcb_screen_allowed_depths_iterator(m_screen);
+    for (; depthIt.rem; xcb_depth_next(&depthIt)) {
+        if (depthIt.data->depth != 32)
+            continue;
+
+        xcb_visualtype_iterator_t visualIt = xcb_depth_visuals_iterator(depthIt.data);
+        for (; visualIt.rem; xcb_visualtype_next(&visualIt)) {
+            if (visualIt.data->_class == XCB_VISUAL_CLASS_TRUE_COLOR) {
+                m_visual = visualIt.data->visual_id;
+                m_depth = 32;
+                break;
+            }
+        }
+
+        if (m_depth == 32)
+            break;
+    }
+
+    m_colormap = xcb_generate_id(m_connection);
+    xcb_create_colormap(m_connection, XCB_COLORMAP_ALLOC_NONE, m_colormap, m_screen->root, m_visual);
+
+    m_contentPixmap = xcb_generate_id(m_connection);
+    xcb_void_cookie_t cookie = xcb_create_pixmap_checked(m_connection, m_depth, m_contentPixmap, m_screen->root,
+                                                         m_contentSize.width(), m_contentSize.height());
+    xcb_generic_error_t *error = xcb_request_check(m_connection, cookie);
+    if (error) {
+        logToFileNO(QString("xcb_create_pixmap failed with error %1").arg(error->error_code));
+        free(error);
+        m_contentPixmap = 0;
+        return false;
+    }
+
+    // The GC is shared by the pixmap and all output windows, which have the same depth
+    m_gc = xcb_generate_id(m_connection);
+    const uint32_t gcValues[] = { kBorderPixel, 0u };
+    xcb_create_gc(m_connection, m_gc, m_contentPixmap, XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES, gcValues);
+
+    xcb_flush(m_connection);
+    return true;
+}
+
+void NativeOverlay::destroyResources()
+{
+    if (m_contentPixmap) {
+        xcb_free_pixmap(m_connection, m_contentPixmap);
+        m_contentPixmap = 0;
+    }
+    if (m_gc) {
+        xcb_free_gc(m_connection, m_gc);
+        m_gc = 0;
+    }
+    if (m_colormap) {
+        xcb_free_colormap(m_connection, m_colormap);
+        m_colormap = 0;
+    }
+    xcb_flush(m_connection);
+}
+
+void NativeOverlay::createOutputWindows()
+{
+    const uint32_t valueMask = XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL | XCB_CW_OVERRIDE_REDIRECT
+                             | XCB_CW_EVENT_MASK | XCB_CW_COLORMAP;
+    const uint32_t values[] = {
+        m_depth == 32 ? kBackgroundPixel : 0u,
+        0u,
+        1u,
+        XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE,
+        m_colormap
+    };
+    const QByteArray title("Foccuss Block Overlay");
+
+    // One right-sized window per output instead of one over the whole virtual screen
+    for (const QRect& geometry : X11Connection::instance()->outputGeometries()) {
+        xcb_window_t window = xcb_generate_id(m_connection);
+        xcb_void_cookie_t cookie = xcb_create_window_checked(m_connection, m_depth, window, m_screen->root,
+                                                             geometry.x(), geometry.y(),
+                                                             geometry.width(), geometry.height(), 0,
+                                                             XCB_WINDOW_CLASS_INPUT_OUTPUT, m_visual,
+                                                             valueMask, values);
+        xcb_generic_error_t *error = xcb_request_check(m_connection, cookie);
+        if (error) {
+            logToFileNO(QString("xcb_create_window failed with error %1").arg(error->error_code));
+            free(error);
+            continue;
+        }
+
+        xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_NAME,
+                            XCB_ATOM_STRING, 8, title.size(), title.constData());
+
+        m_outputWindows.append({ window, geometry });
+    }
+
+    xcb_flush(m_connection);
+}
+
+void NativeOverlay::destroyOutputWindows()
+{
+    for (const OutputWindow& output : std::as_const(m_outputWindows)) {
+        xcb_destroy_window(m_connection, output.window);
+    }
+    m_outputWindows.clear();
+    xcb_flush(m_connection);
+}
+
+const NativeOverlay::OutputWindow* NativeOverlay::outputWindow(xcb_window_t window) const
+{
+    for (const OutputWindow& output : m_outputWindows) {
+        if (output.window == window)
+            return &output;
+    }
+
+    return nullptr;
+}
+
+void NativeOverlay::showOverlay(X11Window targetWindow, const QString& appPath, const QString& appName,
+                                const QList<ProcessRef>& processes)
+{
+    if (!isValid())
+        return;
+
+    for (int i = 0; i < m_targets.size(); ++i) {
+        if (m_targets[i].window == targetWindow) {
+            Target target = m_targets.takeAt(i);
+            target.mapped = true;
+            target.processes = processes;
+            m_targets.append(target);
+            updateVisibility();
+            return;
+        }
+    }
+
+    m_targets.append({ targetWindow, appPath, appName, processes, true });
+    X11Connection::instance()->watchWindow(targetWindow);
+
+    updateVisibility();
+}
+
+void NativeOverlay::hideOverlay()
+{
+    const QList<Target> targets = m_targets;
+    m_targets.clear();
+
+    updateVisibility();
+
+    for (const Target& target : targets) {
+        X11Connection::instance()->unwatchWindow(target.window);
+        emit targetRemoved(target.appPath);
+    }
+}
+
+const NativeOverlay::Target* NativeOverlay::currentTarget() const
+{
+    for (int i = m_targets.size() - 1; i >= 0; --i) {
+        if (m_targets[i].mapped)
+            return &m_targets[i];
+    }
+
+    return nullptr;
+}
+
+void NativeOverlay::updateVisibility()
+{
+    const Target *target = currentTarget();
+
+    if (!target) {
+        if (m_isMapped) {
+            for (const OutputWindow& output : std::as_const(m_outputWindows)) {
+                xcb_unmap_window(m_connection, output.window);
+            }
+            xcb_flush(m_connection);
+            m_isMapped = false;
+        }
+        return;
+    }
+
+    if (target->appName != m_renderedAppName) {
+        m_renderedAppName = target->appName;
+        renderContent();
+    }
+
+    if (!m_isMapped) {
+        mapOverlay();
+    } else {
+        paintAll();
+    }
+}
+
+void NativeOverlay::mapOverlay()
+{
+    if (m_outputWindows.isEmpty())
+        return;
+
+    raiseOverlay();
+    for (const OutputWindow& output : std::as_const(m_outputWindows)) {
+        xcb_map_window(m_connection, output.window);
+    }
+    xcb_set_input_focus(m_connection, XCB_INPUT_FOCUS_POINTER_ROOT,
+                        m_outputWindows.first().window, XCB_CURRENT_TIME);
+    xcb_flush(m_connection);
+
+    m_isMapped = true;
+}
+
+void NativeOverlay::raiseOverlay()
+{
+    const uint32_t stackMode = XCB_STACK_MODE_ABOVE;
+    for (const OutputWindow& output : std::as_const(m_outputWindows)) {
+        xcb_configure_window(m_connection, output.window, XCB_CONFIG_WINDOW_STACK_MODE, &stackMode);
+    }
+    xcb_flush(m_connection);
+}
+
+QRect NativeOverlay::contentRect(const OutputWindow& output) const
+{
+    QRect rect(QPoint(0, 0), m_contentSize);
+    rect.moveCenter(QRect(QPoint(0, 0), output.geometry.size()).center());
+    return rect;
+}
+
+void NativeOverlay::renderContent()
+{
+    QImage image(m_contentSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setRenderHint(QPainter::TextAntialiasing, true);
+
+    painter.setPen(QPen(QColor(255, 0, 0), 2));
+    painter.setBrush(QColor(30, 30, 30, 235));
+    painter.drawRoundedRect(QRectF(image.rect()).adjusted(1, 1, -1, -1), 8, 8);
+
+    QFont font = painter.font();
+    font.setPointSize(16);
+    font.setBold(true);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    painter.drawText(QRect(20, 20, m_contentSize.width() - 40, 40), Qt::AlignCenter,
+                     "This application has been blocked!");
+
+    font.setPointSize(12);
+    font.setBold(false);
+    painter.setFont(font);
+    painter.drawText(QRect(20, 70, m_contentSize.width() - 40, 40), Qt::AlignCenter,
+                     painter.fontMetrics().elidedText(m_renderedAppName, Qt::ElideMiddle,
+                                                      m_contentSize.width() - 40));
+
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0, 120, 215));
+    painter.drawRoundedRect(m_closeButtonRect, 4, 4);
+    painter.setBrush(QColor(200, 40, 40));
+    painter.drawRoundedRect(m_killButtonRect, 4, 4);
+
+    painter.setPen(Qt::white);
+    painter.drawText(m_closeButtonRect, Qt::AlignCenter, "Close Overlay");
+    painter.drawText(m_killButtonRect, Qt::AlignCenter, "Force Close App");
+    painter.end();
+
+    uploadImage(image);
+}
+
+void NativeOverlay::uploadImage(const QImage& image)
+{
+    QImage pixels = image;
+
+    // QImage stores native-endian 32-bit pixels; match the server's byte order
+    const bool serverIsLsbFirst = xcb_get_setup(m_connection)->image_byte_order == XCB_IMAGE_ORDER_LSB_FIRST;
+    const bool hostIsLsbFirst = QSysInfo::ByteOrder == QSysInfo::LittleEndian;
+    if (serverIsLsbFirst != hostIsLsbFirst) {
+        for (int y = 0; y < pixels.height(); ++y) {
+            quint32 *line = reinterpret_cast<quint32*>(pixels.scanLine(y));
+            for (int x = 0; x < pixels.width(); ++x) {
+                line[x] = qbswap(line[x]);
+            }
+        }
+    }
+
+    // Split the upload so no single PutImage exceeds the maximum request size
+    const int stride = pixels.bytesPerLine();
+    const uint32_t maxRequestBytes = xcb_get_maximum_request_length(m_connection) * 4;
+    const int rowsPerRequest = qMax(1, int((maxRequestBytes - 64) / uint32_t(stride)));
+
+    for (int y = 0; y < pixels.height(); y += rowsPerRequest) {
+        const int rows = qMin(rowsPerRequest, pixels.height() - y);
+        xcb_put_image(m_connection, XCB_IMAGE_FORMAT_Z_PIXMAP, m_contentPixmap, m_gc,
+                      pixels.width(), rows, 0, y, 0, m_depth,
+                      rows * stride, pixels.constScanLine(y));
+    }
+
+    xcb_flush(m_connection);
+}
+
+void NativeOverlay::paint(const OutputWindow& output)
+{
+    if (!m_isMapped)
+        return;
+
+    const uint16_t width = output.geometry.width();
+    const uint16_t height = output.geometry.height();
+    const xcb_rectangle_t borders[] = {
+        { 0, 0, width, kBorderWidth },
+        { 0, int16_t(height - kBorderWidth), width, kBorderWidth },
+        { 0, kBorderWidth, kBorderWidth, uint16_t(height - 2 * kBorderWidth) },
+        { int16_t(width - kBorderWidth), kBorderWidth, kBorderWidth, uint16_t(height - 2 * kBorderWidth) }
+    };
+    xcb_poly_fill_rectangle(m_connection, output.window, m_gc, 4, borders);
+
+    const QRect content = contentRect(output);
+    xcb_copy_area(m_connection, m_contentPixmap, output.window, m_gc, 0, 0,
+                  content.x(), content.y(), content.width(), content.height());
+
+    xcb_flush(m_connection);
+}
+
+void NativeOverlay::paintAll()
+{
+    for (const OutputWindow& output : std::as_const(m_outputWindows)) {
+        paint(output);
+    }
+}
+
+void NativeOverlay::onAboutToBlock()
+{
+    if (!m_connection)
+        return;
+
+    xcb_flush(m_connection);
+
+    xcb_generic_event_t *event;
+    while ((event = xcb_poll_for_queued_event(m_connection)) != nullptr) {
+        dispatchEvent(event);
+        free(event);
+    }
+}
+
+void NativeOverlay::processEvents()
+{
+    if (!m_connection)
+        return;
+
+    xcb_generic_event_t *event;
+    while ((event = xcb_poll_for_event(m_connection)) != nullptr) {
+        dispatchEvent(event);
+        free(event);
+    }
+
+    if (xcb_connection_has_error(m_connection)) {
+        logToFileNO("Native overlay lost its X connection");
+        m_notifier->setEnabled(false);
+    }
+}
+
+void NativeOverlay::dispatchEvent(xcb_generic_event_t *event)
+{
+    switch (event->response_type & ~0x80) {
+        case 0: {
+            xcb_generic_error_t *error = reinterpret_cast<xcb_generic_error_t*>(event);
+            logToFileNO(QString("Native overlay X error %1").arg(error->error_code));
+            break;
+        }
+        case XCB_EXPOSE: {
+            xcb_expose_event_t *expose = reinterpret_cast<xcb_expose_event_t*>(event);
+            const OutputWindow *output = outputWindow(expose->window);
+            if (output && expose->count == 0) {
+                paint(*output);
+            }
+            break;
+        }
+        case XCB_BUTTON_RELEASE: {
+            xcb_button_release_event_t *release = reinterpret_cast<xcb_button_release_event_t*>(event);
+            const OutputWindow *output = outputWindow(release->event);
+            if (output && release->detail == XCB_BUTTON_INDEX_1) {
+                onButtonReleased(*output, release->event_x, release->event_y);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void NativeOverlay::onButtonReleased(const OutputWindow& output, int x, int y)
+{
+    const Target *target = currentTarget();
+    if (!target)
+        return;
+
+    const QPoint pos = QPoint(x, y) - contentRect(output).topLeft();
+
+    if (m_closeButtonRect.contains(pos)) {
+        removeTarget(target->window);
+    } else if (m_killButtonRect.contains(pos)) {
+        killCurrentApp();
+    }
+}
+
+void NativeOverlay::killCurrentApp()
+{
+    const Target *target = currentTarget();
+    if (!target)
+        return;
+
+    X11Window window = target->window;
+    emit killRequested(target->processes);
+
+    removeTarget(window);
+}
+
+void NativeOverlay::removeTarget(X11Window window)
+{
+    QString appPath;
+    for (int i = 0; i < m_targets.size(); ++i) {
+        if (m_targets[i].window == window) {
+            appPath = m_targets[i].appPath;
+            m_targets.removeAt(i);
+            X11Connection::instance()->unwatchWindow(window);
+            break;
+        }
+    }
+
+    updateVisibility();
+
+    if (!appPath.isEmpty()) {
+        emit targetRemoved(appPath);
+    }
+
+    if (m_targets.isEmpty()) {
+        emit finished();
+    }
+}
+
+void NativeOverlay::onTargetConfigured(X11Window window, const QRect& geometry)
+{
+    Q_UNUSED(geometry);
+
+    if (!m_isMapped)
+        return;
+
+    for (const Target& target : std::as_const(m_targets)) {
+        if (target.window == window) {
+            raiseOverlay();
+            return;
+        }
+    }
+}
+
+void NativeOverlay::onTargetMapped(X11Window window)
+{
+    for (Target& target : m_targets) {
+        if (target.window == window) {
+            target.mapped = true;
+            updateVisibility();
+            return;
+        }
+    }
+}
+
+void NativeOverlay::onTargetUnmapped(X11Window window)
+{
+    for (Target& target : m_targets) {
+        if (target.window == window) {
+            target.mapped = false;
+            updateVisibility();
+            return;
+        }
+    }
+}
+
+void NativeOverlay::onTargetDestroyed(X11Window window)
+{
+    for (const Target& target : std::as_const(m_targets)) {
+        if (target.window == window) {
+            logToFileNO("Target window no longer exists, removing it from the native overlay");
+            removeTarget(window);
+            return;
+        }
+    }
+}
+
+void NativeOverlay::onScreenLayoutChanged()
+{
+    if (!m_connection)
+        return;
+
+    const bool wasMapped = m_isMapped;
+
+    destroyOutputWindows();
+    m_isMapped = false;
+    createOutputWindows();
+
+    if (wasMapped) {
+        mapOverlay();
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#ifndef NATIVEOVERLAY_H
+#define NATIVEOVERLAY_H
+
+#include "../../include/Common.h"
+#include "../core/processidentity.h"
+
+// Lightweight overlay backend drawn directly over xcb. One
+// override-redirect ARGB window per XRandR output covers the screen for
+// every blocked target; the static content is rendered once into a
+// server-side pixmap and only copied back on Expose. Works without any
+// QWidget, so the headless service can use it as well.
+class NativeOverlay : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NativeOverlay(QObject *parent = nullptr);
+    ~NativeOverlay();
+
+    bool isValid() const;
+
+    void showOverlay(X11Window targetWindow, const QString& appPath, const QString& appName,
+                     const QList<ProcessRef>& processes);
+    void hideOverlay();
+
+signals:
+    void finished();
+    void killRequested(const QList<ProcessRef>& processes);
+    void targetRemoved(const QString& appPath);
+
+private slots:
+    void processEvents();
+    void onAboutToBlock();
+    void onTargetConfigured(X11Window window, const QRect& geometry);
+    void onTargetMapped(X11Window window);
+    void onTargetUnmapped(X11Window window);
+    void onTargetDestroyed(X11Window window);
+    void onScreenLayoutChanged();
+
+private:
+    struct Target
+    {
+        X11Window window;
+        QString appPath;
+        QString appName;
+        QList<ProcessRef> processes;
+        bool mapped;
+    };
+
+    struct OutputWindow
+    {
+        xcb_window_t window;
+        QRect geometry;
+    };
+
+    bool createResources();
+    void destroyResources();
+    void createOutputWindows();
+    void destroyOutputWindows();
+    void renderContent();
+    void uploadImage(const QImage& image);
+    void paint(const OutputWindow& output);
+    void paintAll();
+    void mapOverlay();
+    void raiseOverlay();
+    void updateVisibility();
+    void dispatchEvent(xcb_generic_event_t *event);
+    void onButtonReleased(const OutputWindow& output, int x, int y);
+    void removeTarget(X11Window window);
+    void killCurrentApp();
+    QRect contentRect(const OutputWindow& output) const;
+    const OutputWindow* outputWindow(xcb_window_t window) const;
+    const Target* currentTarget() const;
+
+    xcb_connection_t *m_connection;
+    xcb_screen_t *m_screen;
+    xcb_visualid_t m_visual;
+    uint8_t m_depth;
+    xcb_colormap_t m_colormap;
+    xcb_pixmap_t m_contentPixmap;
+    xcb_gcontext_t m_gc;
+    QSocketNotifier *m_notifier;
+
+    QList<OutputWindow> m_outputWindows;
+    QSize m_contentSize;
+    QRect m_closeButtonRect;
+    QRect m_killButtonRect;
+    QString m_renderedAppName;
+    bool m_isMapped;
+
+    QList<Target> m_targets;
+};
+
+#endif // NATIVEOVERLAY_H
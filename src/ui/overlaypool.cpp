@@ -0,0 +1,182 @@
+#include "overlaypool.h"
+#include "blockoverlay.h"
+#include "../core/x11connection.h"
+
+OverlayPool::OverlayPool(int capacity, QObject *parent)
+    : QObject(parent),
+      m_capacity(qMax(1, capacity))
+{
+    connect(X11Connection::instance(), &X11Connection::screenLayoutChanged,
+            this, &OverlayPool::onScreenLayoutChanged);
+
+    // Warm up once the event loop is running so startup is not delayed
+    QTimer::singleShot(0, this, &OverlayPool::refill);
+}
+
+OverlayPool::~OverlayPool()
+{
+    qDeleteAll(m_idleOverlays);
+    m_idleOverlays.clear();
+
+    for (const QList<BlockOverlay*>& group : std::as_const(m_activeGroups)) {
+        qDeleteAll(group);
+    }
+    m_activeGroups.clear();
+}
+
+void OverlayPool::showOverlay(X11Window targetWindow, const QString& appPath, const QString& appName, const QList<ProcessRef>& processes)
+{
+    QList<BlockOverlay*>& group = m_activeGroups[targetWindow];
+    layoutGroup(group, targetWindow, appPath, appName, processes, true);
+
+    QTimer::singleShot(0, this, &OverlayPool::refill);
+}
+
+void OverlayPool::layoutGroup(QList<BlockOverlay*>& group, X11Window targetWindow, const QString& appPath,
+                              const QString& appName, const QList<ProcessRef>& processes, bool visible)
+{
+    const QList<QRect> outputs = logicalOutputGeometries();
+
+    while (group.size() > outputs.size()) {
+        BlockOverlay *overlay = group.takeLast();
+        overlay->hide();
+        recycle(overlay);
+    }
+
+    while (group.size() < outputs.size()) {
+        BlockOverlay *overlay = acquire();
+        overlay->bind(targetWindow, appPath, appName, processes);
+        group.append(overlay);
+    }
+
+    // The overlay on the primary screen is the one that keeps focus
+    int primaryIndex = 0;
+    QScreen *primaryScreen = QGuiApplication::primaryScreen();
+    if (primaryScreen) {
+        for (int i = 0; i < outputs.size(); ++i) {
+            if (outputs[i].contains(primaryScreen->geometry().center())) {
+                primaryIndex = i;
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < group.size(); ++i) {
+        group[i]->setProcesses(processes);
+        group[i]->setPrimary(i == primaryIndex);
+        group[i]->setOutputGeometry(outputs[i]);
+        if (visible) {
+            group[i]->showOverlay();
+        }
+    }
+}
+
+QList<QRect> OverlayPool::logicalOutputGeometries() const
+{
+    QList<QRect> outputs;
+    const QList<QScreen*> screens = QGuiApplication::screens();
+
+    for (const QRect& output : X11Connection::instance()->outputGeometries()) {
+        // Qt keeps the native origin of a screen and scales only its size
+        QRect logical = output;
+        for (QScreen *screen : screens) {
+            if (screen->geometry().topLeft() == output.topLeft()) {
+                logical = screen->geometry();
+                break;
+            }
+        }
+        outputs.append(logical);
+    }
+
+    if (outputs.isEmpty()) {
+        for (QScreen *screen : screens) {
+            outputs.append(screen->geometry());
+        }
+    }
+
+    return outputs;
+}
+
+BlockOverlay* OverlayPool::acquire()
+{
+    return m_idleOverlays.isEmpty() ? createOverlay() : m_idleOverlays.takeLast();
+}
+
+BlockOverlay* OverlayPool::createOverlay()
+{
+    BlockOverlay *overlay = new BlockOverlay();
+    connect(overlay, &BlockOverlay::finished, this, &OverlayPool::onOverlayFinished);
+    connect(overlay, &BlockOverlay::killRequested, this, &OverlayPool::killRequested);
+    overlay->prewarm();
+    return overlay;
+}
+
+void OverlayPool::refill()
+{
+    const int target = m_capacity * qMax(1, int(X11Connection::instance()->outputGeometries().size()));
+    while (m_idleOverlays.size() < target) {
+        m_idleOverlays.append(createOverlay());
+    }
+}
+
+void OverlayPool::recycle(BlockOverlay *overlay)
+{
+    overlay->unbind();
+    overlay->setPrimary(true);
+
+    const int target = m_capacity * qMax(1, int(X11Connection::instance()->outputGeometries().size()));
+    if (m_idleOverlays.size() < target) {
+        m_idleOverlays.append(overlay);
+    } else {
+        overlay->deleteLater();
+    }
+}
+
+void OverlayPool::onOverlayFinished()
+{
+    BlockOverlay *overlay = qobject_cast<BlockOverlay*>(sender());
+    if (!overlay) {
+        return;
+    }
+
+    for (auto it = m_activeGroups.begin(); it != m_activeGroups.end(); ++it) {
+        if (!it->contains(overlay)) {
+            continue;
+        }
+
+        // Closing one output's overlay dismisses the whole block
+        const QList<BlockOverlay*> group = *it;
+        const QString appPath = overlay->appPath();
+        m_activeGroups.erase(it);
+
+        for (BlockOverlay *sibling : group) {
+            if (sibling != overlay) {
+                sibling->close();
+            }
+        }
+        for (BlockOverlay *member : group) {
+            recycle(member);
+        }
+
+        emit overlayDismissed(appPath);
+        return;
+    }
+}
+
+void OverlayPool::onScreenLayoutChanged()
+{
+    for (auto it = m_activeGroups.begin(); it != m_activeGroups.end(); ++it) {
+        if (it->isEmpty()) {
+            continue;
+        }
+
+        // Groups hidden behind an unmapped target keep waiting for it to map
+        const bool visible = it->first()->isVisible();
+        const QString appPath = it->first()->appPath();
+        const QString appName = it->first()->appName();
+        const QList<ProcessRef> processes = it->first()->processes();
+        layoutGroup(*it, it.key(), appPath, appName, processes, visible);
+    }
+
+    refill();
+}
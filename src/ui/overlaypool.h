@@ -0,0 +1,45 @@
+#pragma once
+#ifndef OVERLAYPOOL_H
+#define OVERLAYPOOL_H
+
+#include "../../include/Common.h"
+#include "../core/processidentity.h"
+
+class BlockOverlay;
+
+// Keeps a few fully constructed, polished and hidden overlays around so
+// that a detection only has to rebind them and map them. Every blocked
+// target gets one overlay per XRandR output.
+class OverlayPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit OverlayPool(int capacity = 2, QObject *parent = nullptr);
+    ~OverlayPool();
+
+    void showOverlay(X11Window targetWindow, const QString& appPath, const QString& appName, const QList<ProcessRef>& processes);
+
+signals:
+    void killRequested(const QList<ProcessRef>& processes);
+    void overlayDismissed(const QString& appPath);
+
+private slots:
+    void onOverlayFinished();
+    void onScreenLayoutChanged();
+    void refill();
+
+private:
+    BlockOverlay* acquire();
+    BlockOverlay* createOverlay();
+    void recycle(BlockOverlay *overlay);
+    void layoutGroup(QList<BlockOverlay*>& group, X11Window targetWindow, const QString& appPath,
+                     const QString& appName, const QList<ProcessRef>& processes, bool visible);
+    QList<QRect> logicalOutputGeometries() const;
+
+    int m_capacity;
+    QList<BlockOverlay*> m_idleOverlays;
+    QHash<X11Window, QList<BlockOverlay*>> m_activeGroups;
+};
+
+#endif // OVERLAYPOOL_H